@@ -0,0 +1,219 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <new>
+
+#ifdef _WIN32
+// Keeps windows.h from defining min and max macros over std::min and std::max
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "metrics.hpp"
+
+namespace ovllm
+{
+    static size_t round_up(size_t value, size_t multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+#ifdef _WIN32
+    // Large pages need SeLockMemoryPrivilege, which is requested once and usually not granted
+    static bool enable_large_pages()
+    {
+        HANDLE token;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+        {
+            return false;
+        }
+        TOKEN_PRIVILEGES privileges = {};
+        privileges.PrivilegeCount = 1;
+        privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        bool enabled = LookupPrivilegeValueW(nullptr, L"SeLockMemoryPrivilege", &privileges.Privileges[0].Luid) &&
+                       AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) && GetLastError() == ERROR_SUCCESS;
+        CloseHandle(token);
+        return enabled && GetLargePageMinimum() != 0;
+    }
+#endif
+
+    Arena::~Arena()
+    {
+        for (const Mapping &block : m_blocks)
+        {
+            unmap(block);
+        }
+        for (const auto &[pointer, mapping] : m_large)
+        {
+            unmap(mapping);
+        }
+    }
+
+    Arena::Mapping Arena::map(size_t bytes)
+    {
+        bytes = round_up(bytes, block_size);
+        Mapping mapping{nullptr, bytes, false};
+#ifdef _WIN32
+        static const bool large_pages = enable_large_pages();
+        if (large_pages && bytes % GetLargePageMinimum() == 0)
+        {
+            mapping.pointer = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            mapping.huge_pages = mapping.pointer != nullptr;
+        }
+        if (mapping.pointer == nullptr)
+        {
+            mapping.pointer = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        }
+        if (mapping.pointer == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+#else
+        // Over-map by a block and trim, so that the mapping starts on a huge page boundary
+        char *raw = static_cast<char *>(mmap(nullptr, bytes + block_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (raw == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+        char *aligned = reinterpret_cast<char *>(round_up(reinterpret_cast<uintptr_t>(raw), block_size));
+        if (aligned != raw)
+        {
+            munmap(raw, aligned - raw);
+        }
+        munmap(aligned + bytes, raw + block_size - aligned);
+        mapping.pointer = aligned;
+#ifdef MADV_HUGEPAGE
+        mapping.huge_pages = madvise(aligned, bytes, MADV_HUGEPAGE) == 0;
+#endif
+#endif
+        Metrics &counters = metrics();
+        counters.arena_reserved_bytes.fetch_add(int64_t(bytes), std::memory_order_relaxed);
+        if (mapping.huge_pages)
+        {
+            counters.arena_huge_page_bytes.fetch_add(int64_t(bytes), std::memory_order_relaxed);
+        }
+        return mapping;
+    }
+
+    void Arena::unmap(const Mapping &mapping)
+    {
+#ifdef _WIN32
+        VirtualFree(mapping.pointer, 0, MEM_RELEASE);
+#else
+        munmap(mapping.pointer, mapping.bytes);
+#endif
+        Metrics &counters = metrics();
+        counters.arena_reserved_bytes.fetch_sub(int64_t(mapping.bytes), std::memory_order_relaxed);
+        if (mapping.huge_pages)
+        {
+            counters.arena_huge_page_bytes.fetch_sub(int64_t(mapping.bytes), std::memory_order_relaxed);
+        }
+    }
+
+    // Every class block is aligned to its size up to the page size, which covers the alignments tensors ask for
+    size_t Arena::size_class(size_t bytes)
+    {
+        size_t index = 0;
+        while (index < class_count && (size_t(1) << (index + min_class_bits)) < bytes)
+        {
+            ++index;
+        }
+        return index;
+    }
+
+    void *Arena::allocate(size_t bytes, size_t alignment)
+    {
+        const size_t index = size_class(std::max({bytes, alignment, size_t(1)}));
+        Metrics &counters = metrics();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (index < class_count)
+        {
+            const size_t size = size_t(1) << (index + min_class_bits);
+            void *pointer = nullptr;
+            if (!m_free[index].empty())
+            {
+                pointer = m_free[index].back();
+                m_free[index].pop_back();
+                counters.arena_reused.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                char *start = reinterpret_cast<char *>(round_up(reinterpret_cast<uintptr_t>(m_cursor), std::min<size_t>(size, 4096)));
+                if (m_cursor == nullptr || start + size > m_end)
+                {
+                    // The rest of the current block is left unused, small allocations are a small share of the arena
+                    m_blocks.push_back(map(block_size));
+                    start = static_cast<char *>(m_blocks.back().pointer);
+                    m_end = start + block_size;
+                }
+                pointer = start;
+                m_cursor = start + size;
+                m_classes.emplace(pointer, uint8_t(index));
+                counters.arena_fresh.fetch_add(1, std::memory_order_relaxed);
+            }
+            counters.arena_in_use_bytes.fetch_add(int64_t(size), std::memory_order_relaxed);
+            return pointer;
+        }
+
+        const size_t size = round_up(bytes, block_size);
+        Mapping mapping;
+        auto cached = m_cached.find(size);
+        if (cached != m_cached.end())
+        {
+            mapping = m_large.at(cached->second);
+            m_cached.erase(cached);
+            m_cached_bytes -= size;
+            counters.arena_reused.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            mapping = map(size);
+            m_large.emplace(mapping.pointer, mapping);
+            counters.arena_fresh.fetch_add(1, std::memory_order_relaxed);
+        }
+        counters.arena_in_use_bytes.fetch_add(int64_t(size), std::memory_order_relaxed);
+        return mapping.pointer;
+    }
+
+    void Arena::deallocate(void *pointer, [[maybe_unused]] size_t bytes, [[maybe_unused]] size_t alignment)
+    {
+        if (pointer == nullptr)
+        {
+            return;
+        }
+        Metrics &counters = metrics();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // The block is looked up by address, bytes only serves as a check of the caller in debug builds
+        auto large = m_large.find(pointer);
+        if (large != m_large.end())
+        {
+            const Mapping mapping = large->second;
+            assert(round_up(bytes, block_size) == mapping.bytes && "Arena::deallocate called with another size than allocate");
+            counters.arena_in_use_bytes.fetch_sub(int64_t(mapping.bytes), std::memory_order_relaxed);
+            if (m_cached_bytes + mapping.bytes <= max_cached_bytes)
+            {
+                m_cached.emplace(mapping.bytes, pointer);
+                m_cached_bytes += mapping.bytes;
+                return;
+            }
+            m_large.erase(large);
+            unmap(mapping);
+            return;
+        }
+        auto slot = m_classes.find(pointer);
+        if (slot == m_classes.end())
+        {
+            assert(false && "Arena::deallocate called with a pointer the arena did not allocate");
+            return;
+        }
+        const size_t index = slot->second;
+        assert(index == size_class(std::max({bytes, alignment, size_t(1)})) && "Arena::deallocate called with another size than allocate");
+        m_free[index].push_back(pointer);
+        counters.arena_in_use_bytes.fetch_sub(int64_t(size_t(1) << (index + min_class_bits)), std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace ovllm
+{
+    // Memory for the tensors the addon creates: input ids, masks, positions and KV cache copies.
+    // Small allocations are carved from 2 MiB blocks and recycled through power-of-two size-class
+    // free lists, large ones get their own mapping and are cached for reuse by size. Mappings are
+    // 2 MiB aligned and advised for transparent huge pages on Linux, and use large pages on Windows
+    // when the process holds the lock memory privilege. Blocks are returned to the system when the
+    // arena is destroyed, which happens after the last tensor allocated from it.
+    class Arena
+    {
+    public:
+        static constexpr size_t block_size = size_t(2) << 20;
+
+        Arena() = default;
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+        ~Arena();
+
+        void *allocate(size_t bytes, size_t alignment);
+        void deallocate(void *pointer, size_t bytes, size_t alignment);
+
+    private:
+        // Size classes from 64 bytes to half a block
+        static constexpr size_t min_class_bits = 6;
+        static constexpr size_t class_count = 15;
+        // Freed large mappings kept for reuse, beyond this they are unmapped
+        static constexpr size_t max_cached_bytes = size_t(256) << 20;
+
+        struct Mapping
+        {
+            void *pointer;
+            size_t bytes;
+            bool huge_pages;
+        };
+
+        // Index of the smallest class that holds bytes, class_count when none does.
+        static size_t size_class(size_t bytes);
+        Mapping map(size_t bytes);
+        void unmap(const Mapping &mapping);
+
+        std::mutex m_mutex;
+        std::vector<void *> m_free[class_count];
+        // Size class of every slot carved from a block. A slot keeps its class when it is recycled, so
+        // deallocate() does not rely on the byte count the caller passes.
+        std::unordered_map<void *, uint8_t> m_classes;
+        std::vector<Mapping> m_blocks;
+        char *m_cursor = nullptr;
+        char *m_end = nullptr;
+        // Live and cached large mappings by address, and the cached ones by size
+        std::map<void *, Mapping> m_large;
+        std::multimap<size_t, void *> m_cached;
+        size_t m_cached_bytes = 0;
+    };
+
+    // ov::Allocator implementation over a shared arena, tensors keep the arena alive.
+    struct ArenaAllocator
+    {
+        std::shared_ptr<Arena> arena;
+
+        void *allocate(size_t bytes, size_t alignment) { return arena->allocate(bytes, alignment); }
+        void deallocate(void *pointer, size_t bytes, size_t alignment) { arena->deallocate(pointer, bytes, alignment); }
+        bool is_equal(const ArenaAllocator &other) const { return arena == other.arena; }
+    };
+}
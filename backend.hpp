@@ -0,0 +1,23 @@
+#pragma once
+
+// The engine the scheduler drives, chosen at compile time. Building with OVLLM_MOCK_BACKEND swaps in
+// the model-free mock, everything above the engine stays the same code.
+#ifdef OVLLM_MOCK_BACKEND
+#include "mock_backend.hpp"
+
+namespace ovllm
+{
+    using BackendEngine = MockEngine;
+    using BackendSession = MockSession;
+    using BackendGeneration = MockGeneration;
+}
+#else
+#include "engine.hpp"
+
+namespace ovllm
+{
+    using BackendEngine = Engine;
+    using BackendSession = Session;
+    using BackendGeneration = Generation;
+}
+#endif
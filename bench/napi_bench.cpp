@@ -0,0 +1,168 @@
+// N-API boundary microbenchmark addon: each export performs one kind of crossing many times, so that
+// bench/napi_bench.js can time them in isolation from inference.
+#include <napi.h>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Utf8Value() of the same string count times, returns the byte length
+Napi::Value Utf8Value(const Napi::CallbackInfo &info)
+{
+    Napi::String text = info[0].As<Napi::String>();
+    const uint32_t count = info[1].As<Napi::Number>().Uint32Value();
+    size_t length = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        length = text.Utf8Value().size();
+    }
+    return Napi::Number::New(info.Env(), double(length));
+}
+
+// Copies the bytes of a Buffer into a string count times, the prompt path of Buffer inputs
+Napi::Value BufferCopy(const Napi::CallbackInfo &info)
+{
+    Napi::Buffer<char> buffer = info[0].As<Napi::Buffer<char>>();
+    const uint32_t count = info[1].As<Napi::Number>().Uint32Value();
+    size_t length = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        length = std::string(buffer.Data(), buffer.Length()).size();
+    }
+    return Napi::Number::New(info.Env(), double(length));
+}
+
+// Napi::String::New of a bytes long string count times
+Napi::Value StringNew(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    const uint32_t count = info[0].As<Napi::Number>().Uint32Value();
+    const std::string text(info[1].As<Napi::Number>().Uint32Value(), 'a');
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Napi::HandleScope scope(env);
+        Napi::String::New(env, text);
+    }
+    return env.Undefined();
+}
+
+// Calls back count times with a short token string, with env.Global() as the receiver or without one
+Napi::Value CallbackPerToken(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::Function callback = info[0].As<Napi::Function>();
+    const uint32_t count = info[1].As<Napi::Number>().Uint32Value();
+    const bool global = info[2].As<Napi::Boolean>().Value();
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Napi::HandleScope scope(env);
+        if (global)
+        {
+            callback.Call(env.Global(), {Napi::String::New(env, " token")});
+        }
+        else
+        {
+            callback.Call({Napi::String::New(env, " token")});
+        }
+    }
+    return env.Undefined();
+}
+
+// Calls back once per chunk of tokens with one string built for the chunk
+Napi::Value CallbackPerChunk(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    Napi::Function callback = info[0].As<Napi::Function>();
+    const uint32_t count = info[1].As<Napi::Number>().Uint32Value();
+    const uint32_t chunkSize = std::max(1u, info[2].As<Napi::Number>().Uint32Value());
+    std::string chunk;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        chunk += " token";
+        if ((i + 1) % chunkSize == 0 || i + 1 == count)
+        {
+            Napi::HandleScope scope(env);
+            callback.Call({Napi::String::New(env, chunk)});
+            chunk.clear();
+        }
+    }
+    return env.Undefined();
+}
+
+struct ThreadTokens
+{
+    Napi::ThreadSafeFunction tsfn;
+    Napi::FunctionReference callback;
+    std::thread thread;
+    uint32_t count = 0;
+    bool coalesce = false;
+    std::mutex mutex;
+    uint32_t pending = 0;
+    uint32_t delivered = 0;
+};
+
+// Runs on the JS thread for each call, or for each drain of the tokens that arrived while it was queued
+static void DeliverTokens(Napi::Env env, ThreadTokens *state, uint32_t tokens)
+{
+    if (state->coalesce)
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        tokens = state->pending;
+        state->pending = 0;
+    }
+    state->delivered += tokens;
+    if (state->delivered == state->count)
+    {
+        state->thread.join();
+        state->tsfn.Release();
+        state->callback.Call({Napi::Number::New(env, state->count)});
+        delete state;
+    }
+}
+
+// Posts count tokens from a native thread through a thread-safe function, like a decode loop feeding
+// the event loop: one call per token, or with coalesce one call per batch the JS thread drains at once.
+// Calls back with the count when all have been delivered.
+Napi::Value ThreadSafeTokens(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    auto *state = new ThreadTokens();
+    state->count = std::max(1u, info[0].As<Napi::Number>().Uint32Value());
+    state->coalesce = info[1].As<Napi::Boolean>().Value();
+    state->callback = Napi::Persistent(info[2].As<Napi::Function>());
+    state->tsfn = Napi::ThreadSafeFunction::New(env, Napi::Function::New(env, [](const Napi::CallbackInfo &) {}), "napi_bench", 0, 1);
+    state->thread = std::thread([state]()
+    {
+        for (uint32_t i = 0; i < state->count; ++i)
+        {
+            bool post = true;
+            if (state->coalesce)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                post = ++state->pending == 1;
+            }
+            if (post)
+            {
+                state->tsfn.BlockingCall([state](Napi::Env env, Napi::Function)
+                {
+                    DeliverTokens(env, state, 1);
+                });
+            }
+        }
+    });
+    return env.Undefined();
+}
+
+Napi::Object Init(Napi::Env env, Napi::Object exports)
+{
+    exports.Set(Napi::String::New(env, "utf8Value"), Napi::Function::New(env, Utf8Value));
+    exports.Set(Napi::String::New(env, "bufferCopy"), Napi::Function::New(env, BufferCopy));
+    exports.Set(Napi::String::New(env, "stringNew"), Napi::Function::New(env, StringNew));
+    exports.Set(Napi::String::New(env, "callbackPerToken"), Napi::Function::New(env, CallbackPerToken));
+    exports.Set(Napi::String::New(env, "callbackPerChunk"), Napi::Function::New(env, CallbackPerChunk));
+    exports.Set(Napi::String::New(env, "threadSafeTokens"), Napi::Function::New(env, ThreadSafeTokens));
+    return exports;
+}
+
+NODE_API_MODULE(napi_bench, Init)
@@ -0,0 +1,52 @@
+// Times N-API boundary crossings in isolation: prompt strings vs Buffers going in, one string and
+// callback per token vs per chunk coming out, and thread-safe function calls per token vs coalesced.
+// Usage: node bench/napi_bench.js [iterations]
+const bench = require('../build/Release/napi_bench');
+
+const iterations = Number(process.argv[2] || 100000);
+
+function time(name, count, run) {
+    run();
+    const start = process.hrtime.bigint();
+    run();
+    const ns = Number(process.hrtime.bigint() - start);
+    console.log(`${name.padEnd(44)} ${(ns / count).toFixed(1).padStart(10)} ns/op`);
+}
+
+function timeAsync(name, count, run) {
+    return new Promise((resolve) => {
+        const start = process.hrtime.bigint();
+        run(() => {
+            const ns = Number(process.hrtime.bigint() - start);
+            console.log(`${name.padEnd(44)} ${(ns / count).toFixed(1).padStart(10)} ns/op`);
+            resolve();
+        });
+    });
+}
+
+async function main() {
+    for (const size of [64, 4096, 65536]) {
+        // Repeated rather than sliced, so V8 holds a flat string as it would for a read file
+        const ascii = 'a'.repeat(size);
+        const twoByte = 'é'.repeat(size / 2);
+        const count = Math.max(10, Math.floor(iterations * 64 / size));
+        time(`Utf8Value, ${size} B one-byte string`, count, () => bench.utf8Value(ascii, count));
+        time(`Utf8Value, ${size} B two-byte string`, count, () => bench.utf8Value(twoByte, count));
+        const buffer = Buffer.from(twoByte);
+        time(`Buffer copy, ${buffer.length} B`, count, () => bench.bufferCopy(buffer, count));
+    }
+    time('String::New, 6 B', iterations, () => bench.stringNew(iterations, 6));
+    time('String::New, 4096 B', iterations / 10, () => bench.stringNew(iterations / 10, 4096));
+
+    const noop = () => false;
+    time('callback per token, env.Global() receiver', iterations, () => bench.callbackPerToken(noop, iterations, true));
+    time('callback per token, undefined receiver', iterations, () => bench.callbackPerToken(noop, iterations, false));
+    for (const chunkSize of [4, 16]) {
+        time(`callback per ${chunkSize} token chunk, per token`, iterations, () => bench.callbackPerChunk(noop, iterations, chunkSize));
+    }
+
+    await timeAsync('threadsafe call per token', iterations, (done) => bench.threadSafeTokens(iterations, false, done));
+    await timeAsync('threadsafe call per drained batch, per token', iterations, (done) => bench.threadSafeTokens(iterations, true, done));
+}
+
+main();
@@ -0,0 +1,82 @@
+// Sampler microbenchmark over the vocabulary sizes of supported models.
+// Usage: sampler_bench [iterations]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../sampler.hpp"
+
+struct Case
+{
+    const char *name;
+    ovllm::SamplerConfig config;
+};
+
+int main(int argc, char **argv)
+{
+    const size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200;
+    // TinyLlama/Llama 2, GPT-2, Llama 3, Qwen2
+    const size_t vocab_sizes[] = {32000, 50257, 128256, 151936};
+
+    ovllm::SamplerConfig greedy;
+    ovllm::SamplerConfig top_k;
+    top_k.do_sample = true;
+    top_k.temperature = 0.7f;
+    top_k.top_k = 50;
+    ovllm::SamplerConfig top_p = top_k;
+    top_p.top_k = 0;
+    top_p.top_p = 0.9f;
+    ovllm::SamplerConfig top_k_p = top_k;
+    top_k_p.top_p = 0.9f;
+    top_k_p.repetition_penalty = 1.1f;
+    ovllm::SamplerConfig multinomial;
+    multinomial.do_sample = true;
+    const Case cases[] = {
+        {"greedy", greedy},
+        {"top_k=50", top_k},
+        {"top_p=0.9", top_p},
+        {"top_k=50,top_p=0.9,rep=1.1", top_k_p},
+        {"multinomial", multinomial},
+    };
+
+    std::printf("%-28s %8s %12s\n", "config", "vocab", "us/token");
+    for (size_t vocab : vocab_sizes)
+    {
+        // Logits shaped like a real model's: a few strong candidates over a wide low tail
+        std::mt19937 generator(42);
+        std::normal_distribution<float> noise(0.0f, 2.0f);
+        std::vector<float> logits(vocab);
+        for (float &logit : logits)
+        {
+            logit = noise(generator);
+        }
+        for (size_t i = 0; i < 8; ++i)
+        {
+            logits[generator() % vocab] += 12.0f;
+        }
+
+        for (const Case &bench : cases)
+        {
+            ovllm::Sampler sampler(bench.config, vocab, 1234);
+            for (int64_t token = 0; token < 64; ++token)
+            {
+                sampler.observe(token * 7 % vocab);
+            }
+            std::vector<float> row(vocab);
+            double total = 0.0;
+            int64_t checksum = 0;
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                row = logits;
+                auto start = std::chrono::steady_clock::now();
+                checksum += sampler.sample(row.data());
+                total += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            }
+            std::printf("%-28s %8zu %12.2f  (%lld)\n", bench.name, vocab, total / iterations, static_cast<long long>(checksum % 1000));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,230 @@
+// Scheduler overhead benchmark on the mock backend, runs without a model. Fails when an overhead
+// exceeds its stored baseline by more than the tolerance.
+// Usage: scheduler_bench [--baseline bench/scheduler_baseline.json] [--tolerance 1.5] [--write-baseline]
+//                        [--requests 64] [--concurrency 4] [--prompt-tokens 1024] [--output-tokens 64]
+//                        [--prefill-us 2000] [--tokens-per-second 2000] [--round-trips 2000]
+// Built with OVLLM_MOCK_BACKEND, the scheduler drives MockEngine.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef OVLLM_MOCK_BACKEND
+#error "scheduler_bench drives the mock backend, build it with OVLLM_MOCK_BACKEND defined"
+#endif
+
+#include "../scheduler.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static double microseconds(Clock::duration duration)
+{
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+static double percentile(std::vector<double> values, double quantile)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, size_t(quantile * values.size()))];
+}
+
+static ovllm::Request make_request(size_t prompt_tokens, size_t output_tokens)
+{
+    ovllm::Request request;
+    request.prompt.assign(prompt_tokens, 1);
+    request.config.max_new_tokens = output_tokens;
+    request.config.ignore_eos = true;
+    return request;
+}
+
+// Every request submitted at once, the worker is never idle. Whatever the wall time exceeds the
+// mock's synthetic forward passes by is scheduling, bookkeeping and token callback overhead.
+static void measure_throughput(const std::map<std::string, std::string> &args, std::map<std::string, double> &results)
+{
+    const size_t requests = std::stoul(args.at("--requests"));
+    const size_t concurrency = std::stoul(args.at("--concurrency"));
+    const size_t prompt_tokens = std::stoul(args.at("--prompt-tokens"));
+    const size_t output_tokens = std::stoul(args.at("--output-tokens"));
+    ovllm::MockOptions options;
+    options.prefill_latency = std::chrono::microseconds(std::stoul(args.at("--prefill-us")));
+    options.tokens_per_second = std::stod(args.at("--tokens-per-second"));
+    ovllm::MockEngine engine(options);
+
+    const size_t chunk = options.prefill_chunk;
+    const size_t prefill_passes = (prompt_tokens + chunk - 1) / chunk;
+    const double prefill_us = double(options.prefill_latency.count()) * prompt_tokens / chunk;
+    const double decode_us = options.tokens_per_second > 0.0 ? 1e6 / options.tokens_per_second : 0.0;
+    const double ideal_us = requests * (prefill_us + (output_tokens - 1) * decode_us);
+    const size_t passes = requests * (prefill_passes + output_tokens - 1);
+
+    std::mutex mutex;
+    std::vector<std::vector<Clock::time_point>> tokens(requests);
+    std::promise<void> finished;
+    size_t done = 0;
+    const Clock::time_point start = Clock::now();
+    {
+        ovllm::SchedulerConfig config;
+        config.max_sessions = concurrency;
+        ovllm::Scheduler scheduler(engine, config);
+        for (size_t i = 0; i < requests; ++i)
+        {
+            ovllm::Request request = make_request(prompt_tokens, output_tokens);
+            std::vector<Clock::time_point> &stamps = tokens[i];
+            request.on_token = [&stamps](int64_t)
+            {
+                stamps.push_back(Clock::now());
+                return false;
+            };
+            scheduler.submit(std::move(request), [&](ovllm::Result &&, std::exception_ptr)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (++done == requests)
+                {
+                    finished.set_value();
+                }
+            });
+        }
+        finished.get_future().wait();
+    }
+    const double wall_us = microseconds(Clock::now() - start);
+
+    // With every session decoding, a token waits for one step of each session
+    std::vector<double> excess;
+    for (const std::vector<Clock::time_point> &stamps : tokens)
+    {
+        for (size_t j = 1; j < stamps.size(); ++j)
+        {
+            excess.push_back(microseconds(stamps[j] - stamps[j - 1]) - concurrency * decode_us);
+        }
+    }
+    results["step_overhead_us"] = std::max(0.0, wall_us - ideal_us) / passes;
+    results["itl_overhead_us_p50"] = std::max(0.0, percentile(excess, 0.5));
+}
+
+// One request at a time on an idle scheduler with free forward passes: the round trip from submit to
+// completion is queueing, worker wake-up and completion overhead.
+static void measure_round_trip(const std::map<std::string, std::string> &args, std::map<std::string, double> &results)
+{
+    ovllm::MockOptions options;
+    options.prefill_latency = std::chrono::microseconds(0);
+    options.tokens_per_second = 0.0;
+    ovllm::MockEngine engine(options);
+    ovllm::Scheduler scheduler(engine, ovllm::SchedulerConfig());
+
+    const size_t count = std::stoul(args.at("--round-trips"));
+    std::vector<double> round_trips;
+    for (size_t i = 0; i < count; ++i)
+    {
+        std::promise<Clock::time_point> completed;
+        std::future<Clock::time_point> completion = completed.get_future();
+        const Clock::time_point submitted = Clock::now();
+        scheduler.submit(make_request(1, 1), [&completed](ovllm::Result &&, std::exception_ptr)
+        {
+            completed.set_value(Clock::now());
+        });
+        round_trips.push_back(microseconds(completion.get() - submitted));
+    }
+    results["round_trip_us_p50"] = percentile(round_trips, 0.5);
+    results["round_trip_us_p99"] = percentile(round_trips, 0.99);
+}
+
+static std::map<std::string, double> read_baseline(const std::string &path)
+{
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    const std::string json = text.str();
+    // Flat object of numbers
+    std::map<std::string, double> baseline;
+    for (size_t key = json.find('"'); key != std::string::npos; key = json.find('"', key))
+    {
+        const size_t end = json.find('"', key + 1);
+        const size_t colon = json.find(':', end);
+        if (end == std::string::npos || colon == std::string::npos)
+        {
+            break;
+        }
+        baseline[json.substr(key + 1, end - key - 1)] = std::strtod(json.c_str() + colon + 1, nullptr);
+        key = colon;
+    }
+    return baseline;
+}
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, std::string> args = {{"--baseline", "bench/scheduler_baseline.json"}, {"--tolerance", "1.5"},
+                                               {"--requests", "64"}, {"--concurrency", "4"}, {"--prompt-tokens", "1024"},
+                                               {"--output-tokens", "64"}, {"--prefill-us", "2000"},
+                                               {"--tokens-per-second", "2000"}, {"--round-trips", "2000"}};
+    bool write = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--write-baseline")
+        {
+            write = true;
+        }
+        else if (i + 1 < argc)
+        {
+            args[argv[i]] = argv[i + 1];
+            ++i;
+        }
+    }
+
+    std::map<std::string, double> results;
+    try
+    {
+        measure_throughput(args, results);
+        measure_round_trip(args, results);
+    }
+    catch (const std::exception &error)
+    {
+        std::fprintf(stderr, "scheduler_bench: %s\n", error.what());
+        return 1;
+    }
+
+    if (write)
+    {
+        std::ofstream file(args["--baseline"]);
+        file << "{\n";
+        for (auto result = results.begin(); result != results.end(); ++result)
+        {
+            file << "    \"" << result->first << "\": " << result->second << (std::next(result) == results.end() ? "\n" : ",\n");
+        }
+        file << "}\n";
+        std::printf("Wrote %s\n", args["--baseline"].c_str());
+    }
+
+    const std::map<std::string, double> baseline = write ? results : read_baseline(args["--baseline"]);
+    const double tolerance = std::stod(args["--tolerance"]);
+    bool regressed = false;
+    std::printf("%-24s %12s %12s\n", "overhead", "measured", "baseline");
+    for (const auto &[name, value] : results)
+    {
+        auto limit = baseline.find(name);
+        if (limit == baseline.end())
+        {
+            std::printf("%-24s %12.2f %12s\n", name.c_str(), value, "-");
+            continue;
+        }
+        const bool failed = value > limit->second * tolerance;
+        regressed |= failed;
+        std::printf("%-24s %12.2f %12.2f%s\n", name.c_str(), value, limit->second, failed ? "  REGRESSION" : "");
+    }
+    if (baseline.empty())
+    {
+        std::fprintf(stderr, "No baseline at %s, run with --write-baseline\n", args["--baseline"].c_str());
+        return 1;
+    }
+    return regressed ? 1 : 0;
+}
@@ -0,0 +1,338 @@
+// Serving benchmark: replays a prompt corpus through the engine and scheduler at a fixed concurrency
+// and prints latency, throughput and resource usage as JSON.
+// Usage: serving_bench <model dir> [--device CPU] [--corpus prompts.txt] [--requests 64] [--concurrency 4]
+//                      [--prompt-tokens uniform:128:1024] [--output-tokens fixed:128] [--seed 42]
+//                      [--warmup 2] [--prefill-chunk 512]
+// Lengths are fixed:N, uniform:MIN:MAX or normal:MEAN:STDDEV, in tokens. Prompts are windows of the
+// tokenized corpus, outputs ignore EOS so that every request generates exactly its length.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+// Keeps windows.h from defining min and max macros over std::min and std::max
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "../engine.hpp"
+#include "../scheduler.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+struct Distribution
+{
+    std::string kind = "fixed";
+    double a = 128;
+    double b = 0;
+
+    size_t draw(std::mt19937_64 &generator) const
+    {
+        double value = a;
+        if (kind == "uniform")
+        {
+            value = std::uniform_real_distribution<double>(a, b)(generator);
+        }
+        else if (kind == "normal")
+        {
+            value = std::normal_distribution<double>(a, b)(generator);
+        }
+        return size_t(std::max(1.0, std::round(value)));
+    }
+
+    std::string describe() const
+    {
+        return kind == "fixed" ? kind + ":" + std::to_string(size_t(a)) : kind + ":" + std::to_string(a) + ":" + std::to_string(b);
+    }
+};
+
+static Distribution parse_distribution(const std::string &text)
+{
+    Distribution distribution;
+    const size_t first = text.find(':');
+    if (first == std::string::npos)
+    {
+        throw std::invalid_argument("Expected a length as fixed:N, uniform:MIN:MAX or normal:MEAN:STDDEV, got " + text);
+    }
+    distribution.kind = text.substr(0, first);
+    const size_t second = text.find(':', first + 1);
+    distribution.a = std::stod(text.substr(first + 1, second - first - 1));
+    if (distribution.kind != "fixed")
+    {
+        if (second == std::string::npos || (distribution.kind != "uniform" && distribution.kind != "normal"))
+        {
+            throw std::invalid_argument("Unknown length distribution " + text);
+        }
+        distribution.b = std::stod(text.substr(second + 1));
+    }
+    return distribution;
+}
+
+struct ResourceUsage
+{
+    double peak_rss_mb = 0.0;
+    // User plus system CPU time of the process
+    double cpu_seconds = 0.0;
+};
+
+static ResourceUsage resource_usage()
+{
+    ResourceUsage usage;
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS memory;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory)))
+    {
+        usage.peak_rss_mb = memory.PeakWorkingSetSize / (1024.0 * 1024.0);
+    }
+    FILETIME creation, exit, kernel, user;
+    if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    {
+        auto seconds = [](const FILETIME &time)
+        {
+            return ((uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e7;
+        };
+        usage.cpu_seconds = seconds(kernel) + seconds(user);
+    }
+#else
+    rusage self;
+    if (getrusage(RUSAGE_SELF, &self) == 0)
+    {
+#ifdef __APPLE__
+        usage.peak_rss_mb = self.ru_maxrss / (1024.0 * 1024.0);
+#else
+        usage.peak_rss_mb = self.ru_maxrss / 1024.0;
+#endif
+        usage.cpu_seconds = self.ru_utime.tv_sec + self.ru_utime.tv_usec / 1e6 + self.ru_stime.tv_sec + self.ru_stime.tv_usec / 1e6;
+    }
+#endif
+    return usage;
+}
+
+static std::string percentiles(std::vector<double> values)
+{
+    if (values.empty())
+    {
+        return "null";
+    }
+    std::sort(values.begin(), values.end());
+    auto rank = [&values](double quantile)
+    {
+        return values[std::min(values.size() - 1, size_t(std::ceil(quantile * values.size())) - (quantile > 0.0))];
+    };
+    double sum = 0.0;
+    for (double value : values)
+    {
+        sum += value;
+    }
+    char text[256];
+    std::snprintf(text, sizeof(text), "{\"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}", sum / values.size(),
+                  rank(0.5), rank(0.9), rank(0.99), values.back());
+    return text;
+}
+
+static std::string json_string(const std::string &text)
+{
+    std::string escaped;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+static double milliseconds(Clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+struct Sample
+{
+    Clock::time_point submitted;
+    std::vector<Clock::time_point> tokens;
+    bool failed = false;
+};
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "Usage: serving_bench <model dir> [--device CPU] [--corpus prompts.txt] [--requests 64] [--concurrency 4]\n"
+                             "       [--prompt-tokens uniform:128:1024] [--output-tokens fixed:128] [--seed 42] [--warmup 2] [--prefill-chunk 512]\n");
+        return 1;
+    }
+    std::map<std::string, std::string> args = {{"--device", "CPU"}, {"--requests", "64"}, {"--concurrency", "4"},
+                                               {"--prompt-tokens", "uniform:128:1024"}, {"--output-tokens", "fixed:128"},
+                                               {"--seed", "42"}, {"--warmup", "2"}, {"--prefill-chunk", "512"}};
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        args[argv[i]] = argv[i + 1];
+    }
+
+    try
+    {
+        const size_t requests = std::stoul(args["--requests"]);
+        const size_t concurrency = std::max<size_t>(1, std::stoul(args["--concurrency"]));
+        const size_t warmup = std::stoul(args["--warmup"]);
+        const Distribution prompt_tokens = parse_distribution(args["--prompt-tokens"]);
+        const Distribution output_tokens = parse_distribution(args["--output-tokens"]);
+        std::mt19937_64 generator(std::stoull(args["--seed"]));
+
+        ovllm::EngineOptions options;
+        options.prefill_chunk = std::stoul(args["--prefill-chunk"]);
+        const Clock::time_point load_start = Clock::now();
+        ovllm::Engine engine(argv[1], args["--device"], options);
+        const double load_ms = milliseconds(Clock::now() - load_start);
+
+        // Token pool the prompts are cut from
+        std::string corpus = "The quick brown fox jumps over the lazy dog while the model reads a long document. ";
+        if (args.count("--corpus"))
+        {
+            std::ifstream file(args["--corpus"], std::ios::binary);
+            if (!file)
+            {
+                throw std::runtime_error("Cannot read " + args["--corpus"]);
+            }
+            corpus.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        const std::vector<int64_t> pool = engine.encode(corpus);
+        if (pool.empty())
+        {
+            throw std::runtime_error("Corpus has no tokens");
+        }
+
+        ovllm::SchedulerConfig scheduler_config;
+        scheduler_config.max_sessions = concurrency;
+        ovllm::Scheduler scheduler(engine, scheduler_config);
+
+        const size_t total = warmup + requests;
+        std::vector<Sample> samples(total);
+        std::vector<ovllm::Request> queue(total);
+        for (ovllm::Request &request : queue)
+        {
+            const size_t length = prompt_tokens.draw(generator);
+            const size_t offset = std::uniform_int_distribution<size_t>(0, pool.size() - 1)(generator);
+            for (size_t i = 0; i < length; ++i)
+            {
+                request.prompt.push_back(pool[(offset + i) % pool.size()]);
+            }
+            request.config = engine.generation_config();
+            request.config.do_sample = false;
+            request.config.ignore_eos = true;
+            request.config.max_new_tokens = output_tokens.draw(generator);
+        }
+
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t in_flight = 0;
+        size_t done = 0;
+        Clock::time_point measured_start;
+        ResourceUsage usage_start;
+
+        // Closed loop: a new request is submitted as soon as one of the concurrent ones finishes.
+        // Warmup requests run first, alone, and are left out of the results.
+        for (size_t i = 0; i < total; ++i)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                const size_t limit = i < warmup ? 1 : concurrency;
+                finished.wait(lock, [&] { return in_flight < limit && (i != warmup || done == warmup); });
+                ++in_flight;
+            }
+            if (i == warmup)
+            {
+                measured_start = Clock::now();
+                usage_start = resource_usage();
+            }
+            Sample &sample = samples[i];
+            ovllm::Request &request = queue[i];
+            request.on_token = [&sample](int64_t)
+            {
+                sample.tokens.push_back(Clock::now());
+                return false;
+            };
+            sample.submitted = Clock::now();
+            scheduler.submit(std::move(request), [&, i](ovllm::Result &&, std::exception_ptr error)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                samples[i].failed = error != nullptr;
+                --in_flight;
+                ++done;
+                finished.notify_all();
+            });
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&] { return done == total; });
+        }
+        const double duration = std::chrono::duration<double>(Clock::now() - measured_start).count();
+        const ResourceUsage usage_end = resource_usage();
+
+        std::vector<double> ttft, inter_token, end_to_end;
+        size_t failed = 0;
+        size_t prompt_total = 0;
+        size_t generated = 0;
+        for (size_t i = warmup; i < total; ++i)
+        {
+            const Sample &sample = samples[i];
+            failed += sample.failed;
+            if (sample.tokens.empty())
+            {
+                continue;
+            }
+            prompt_total += queue[i].prompt.size();
+            generated += sample.tokens.size();
+            ttft.push_back(milliseconds(sample.tokens.front() - sample.submitted));
+            end_to_end.push_back(milliseconds(sample.tokens.back() - sample.submitted));
+            for (size_t j = 1; j < sample.tokens.size(); ++j)
+            {
+                inter_token.push_back(milliseconds(sample.tokens[j] - sample.tokens[j - 1]));
+            }
+        }
+
+        const double cpu_seconds = usage_end.cpu_seconds - usage_start.cpu_seconds;
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        std::printf("{\n");
+        std::printf("  \"driver\": \"native\",\n");
+        std::printf("  \"config\": {\"model\": \"%s\", \"device\": \"%s\", \"requests\": %zu, \"concurrency\": %zu, \"prompt_tokens\": \"%s\", "
+                    "\"output_tokens\": \"%s\", \"seed\": %llu, \"warmup\": %zu, \"prefill_chunk\": %zu},\n",
+                    json_string(argv[1]).c_str(), json_string(args["--device"]).c_str(), requests, concurrency, prompt_tokens.describe().c_str(),
+                    output_tokens.describe().c_str(), std::stoull(args["--seed"]), warmup, options.prefill_chunk);
+        std::printf("  \"model_load_ms\": %.1f,\n", load_ms);
+        std::printf("  \"failed_requests\": %zu,\n", failed);
+        std::printf("  \"duration_s\": %.3f,\n", duration);
+        std::printf("  \"requests_per_second\": %.3f,\n", requests / duration);
+        std::printf("  \"output_tokens_per_second\": %.2f,\n", generated / duration);
+        std::printf("  \"total_tokens_per_second\": %.2f,\n", (prompt_total + generated) / duration);
+        std::printf("  \"ttft_ms\": %s,\n", percentiles(ttft).c_str());
+        std::printf("  \"inter_token_ms\": %s,\n", percentiles(inter_token).c_str());
+        std::printf("  \"end_to_end_ms\": %s,\n", percentiles(end_to_end).c_str());
+        std::printf("  \"peak_rss_mb\": %.1f,\n", usage_end.peak_rss_mb);
+        std::printf("  \"cpu_utilization\": %.3f\n", cpu_seconds / (duration * cores));
+        std::printf("}\n");
+        return failed == 0 ? 0 : 2;
+    }
+    catch (const std::exception &error)
+    {
+        std::fprintf(stderr, "serving_bench: %s\n", error.what());
+        return 1;
+    }
+}
@@ -0,0 +1,183 @@
+// Serving benchmark through the addon: replays a prompt corpus with generateAsync at a fixed
+// concurrency and prints latency, throughput and resource usage as JSON, in the schema of
+// serving_bench.cpp. Latencies are measured where JS sees text chunks, so they include the
+// N-API boundary and detokenization.
+// Usage: node bench/serving_bench.js <model dir> [--device CPU] [--corpus prompts.txt] [--requests 64]
+//        [--concurrency 4] [--prompt-tokens uniform:128:1024] [--output-tokens fixed:128] [--seed 42]
+//        [--warmup 2] [--prefill-chunk 512]
+const fs = require('fs');
+const os = require('os');
+const ovllm = require('../build/Release/ovllm');
+
+if (process.argv.length < 3) {
+    console.error('Usage: node bench/serving_bench.js <model dir> [--device CPU] [--corpus prompts.txt] [--requests 64] [--concurrency 4]');
+    process.exit(1);
+}
+const modelPath = process.argv[2];
+const args = {
+    '--device': 'CPU', '--requests': '64', '--concurrency': '4', '--prompt-tokens': 'uniform:128:1024',
+    '--output-tokens': 'fixed:128', '--seed': '42', '--warmup': '2', '--prefill-chunk': '512',
+};
+for (let i = 3; i + 1 < process.argv.length; i += 2) {
+    args[process.argv[i]] = process.argv[i + 1];
+}
+
+// mulberry32, a small seeded generator so that runs replay the same lengths and prompts
+function random(seed) {
+    let state = seed >>> 0;
+    return () => {
+        state = (state + 0x6D2B79F5) >>> 0;
+        let t = state;
+        t = Math.imul(t ^ (t >>> 15), t | 1);
+        t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+        return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+    };
+}
+
+function parseDistribution(text) {
+    const [kind, a, b] = text.split(':');
+    if (kind === 'fixed' && a !== undefined) {
+        return { text, draw: () => Math.max(1, Math.round(Number(a))) };
+    }
+    if (kind === 'uniform' && b !== undefined) {
+        return { text, draw: (next) => Math.max(1, Math.round(Number(a) + next() * (Number(b) - Number(a)))) };
+    }
+    if (kind === 'normal' && b !== undefined) {
+        // Box-Muller
+        return {
+            text,
+            draw: (next) => Math.max(1, Math.round(Number(a) + Number(b) * Math.sqrt(-2 * Math.log(1 - next())) * Math.cos(2 * Math.PI * next()))),
+        };
+    }
+    throw new Error(`Expected a length as fixed:N, uniform:MIN:MAX or normal:MEAN:STDDEV, got ${text}`);
+}
+
+function percentiles(values) {
+    if (values.length === 0) {
+        return null;
+    }
+    values.sort((x, y) => x - y);
+    const rank = (quantile) => values[Math.min(values.length - 1, Math.max(0, Math.ceil(quantile * values.length) - 1))];
+    const round = (value) => Math.round(value * 1000) / 1000;
+    const mean = values.reduce((sum, value) => sum + value, 0) / values.length;
+    return { mean: round(mean), p50: round(rank(0.5)), p90: round(rank(0.9)), p99: round(rank(0.99)), max: round(values[values.length - 1]) };
+}
+
+function now() {
+    return Number(process.hrtime.bigint()) / 1e6;
+}
+
+async function main() {
+    const requests = Number(args['--requests']);
+    const concurrency = Math.max(1, Number(args['--concurrency']));
+    const warmup = Number(args['--warmup']);
+    const promptTokens = parseDistribution(args['--prompt-tokens']);
+    const outputTokens = parseDistribution(args['--output-tokens']);
+    const next = random(Number(args['--seed']));
+
+    const loadStart = now();
+    ovllm.initialize(modelPath, args['--device'], false, {
+        maxSessions: concurrency,
+        prefillChunk: Number(args['--prefill-chunk']),
+    });
+    const loadMs = now() - loadStart;
+
+    const corpus = args['--corpus'] !== undefined
+        ? fs.readFileSync(args['--corpus'], 'utf8')
+        : 'The quick brown fox jumps over the lazy dog while the model reads a long document. ';
+    const pool = ovllm.tokenize(corpus);
+    if (pool.length === 0) {
+        throw new Error('Corpus has no tokens');
+    }
+
+    const total = warmup + requests;
+    const queue = [];
+    for (let i = 0; i < total; ++i) {
+        const length = promptTokens.draw(next);
+        const offset = Math.floor(next() * pool.length);
+        const prompt = new Int32Array(length);
+        for (let j = 0; j < length; ++j) {
+            prompt[j] = pool[(offset + j) % pool.length];
+        }
+        queue.push({ prompt, maxNewTokens: outputTokens.draw(next) });
+    }
+
+    const samples = [];
+    async function run(request) {
+        const sample = { submitted: now(), chunks: [], promptTokens: request.prompt.length, generatedTokens: 0, failed: false };
+        try {
+            const { stats } = await ovllm.generateAsync(request.prompt, { maxNewTokens: request.maxNewTokens, ignoreEos: true }, () => {
+                sample.chunks.push(now());
+            });
+            sample.generatedTokens = stats.generatedTokens;
+        }
+        catch (error) {
+            sample.failed = true;
+        }
+        sample.finished = now();
+        return sample;
+    }
+
+    for (let i = 0; i < warmup; ++i) {
+        await run(queue[i]);
+    }
+
+    // Closed loop: each worker submits its next request as soon as the previous one finishes
+    const start = now();
+    const usageStart = process.cpuUsage();
+    let submitted = warmup;
+    async function worker() {
+        while (submitted < total) {
+            samples.push(await run(queue[submitted++]));
+        }
+    }
+    await Promise.all(Array.from({ length: concurrency }, worker));
+    const duration = (now() - start) / 1000;
+    const cpu = process.cpuUsage(usageStart);
+
+    const ttft = [];
+    const interToken = [];
+    const endToEnd = [];
+    let promptTotal = 0;
+    let generated = 0;
+    for (const sample of samples) {
+        if (sample.chunks.length === 0) {
+            continue;
+        }
+        promptTotal += sample.promptTokens;
+        generated += sample.generatedTokens;
+        ttft.push(sample.chunks[0] - sample.submitted);
+        endToEnd.push(sample.finished - sample.submitted);
+        for (let j = 1; j < sample.chunks.length; ++j) {
+            interToken.push(sample.chunks[j] - sample.chunks[j - 1]);
+        }
+    }
+
+    const report = {
+        driver: 'node',
+        config: {
+            model: modelPath, device: args['--device'], requests, concurrency, prompt_tokens: promptTokens.text,
+            output_tokens: outputTokens.text, seed: Number(args['--seed']), warmup, prefill_chunk: Number(args['--prefill-chunk']),
+        },
+        model_load_ms: Math.round(loadMs * 10) / 10,
+        failed_requests: samples.filter((sample) => sample.failed).length,
+        duration_s: duration,
+        requests_per_second: requests / duration,
+        output_tokens_per_second: generated / duration,
+        total_tokens_per_second: (promptTotal + generated) / duration,
+        ttft_ms: percentiles(ttft),
+        // Between text chunks, which can hold several tokens while a UTF-8 sequence is incomplete
+        inter_token_ms: percentiles(interToken),
+        end_to_end_ms: percentiles(endToEnd),
+        peak_rss_mb: process.resourceUsage().maxRSS / 1024,
+        cpu_utilization: (cpu.user + cpu.system) / 1e6 / (duration * os.cpus().length),
+    };
+    console.log(JSON.stringify(report, null, 2));
+    ovllm.cleanup();
+    process.exitCode = report.failed_requests === 0 ? 0 : 2;
+}
+
+main().catch((error) => {
+    console.error(`serving_bench: ${error.message}`);
+    process.exit(1);
+});
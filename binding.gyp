@@ -6,6 +6,22 @@
             "cflags_cc!": ["-fno-exceptions"],
             "sources": [
                 "ovllm.cpp",
+                "arena.cpp",
+                "cpu_features.cpp",
+                "engine.cpp",
+                "grammar.cpp",
+                "logits_processor.cpp",
+                "metrics.cpp",
+                "model_transforms.cpp",
+                "profiler.cpp",
+                "sampler.cpp",
+                "scheduler.cpp",
+                "prompt_lookup.cpp",
+                "response_cache.cpp",
+                "stop_matcher.cpp",
+                "text_streamer.cpp",
+                "token_streamer.cpp",
+                "tracer.cpp",
             ],
             "include_dirs": [
                 "<!@(node -p \"require('node-addon-api').include\")",
@@ -17,6 +33,111 @@
             ],
             "dependencies": ["<!(node -p \"require('node-addon-api').gyp\")"],
             "defines": ["NAPI_DISABLE_CPP_EXCEPTIONS"],
+        },
+        {
+            "target_name": "sampler_bench",
+            "type": "executable",
+            "sources": [
+                "cpu_features.cpp",
+                "sampler.cpp",
+                "bench/sampler_bench.cpp",
+            ],
+        },
+        {
+            "target_name": "napi_bench",
+            "sources": ["bench/napi_bench.cpp"],
+            "include_dirs": ["<!@(node -p \"require('node-addon-api').include\")"],
+            "dependencies": ["<!(node -p \"require('node-addon-api').gyp\")"],
+            "defines": ["NAPI_DISABLE_CPP_EXCEPTIONS"],
+        },
+        {
+            "target_name": "scheduler_bench",
+            "type": "executable",
+            "cflags!": ["-fno-exceptions"],
+            "cflags_cc!": ["-fno-exceptions"],
+            "sources": [
+                "metrics.cpp",
+                "mock_backend.cpp",
+                "scheduler.cpp",
+                "tracer.cpp",
+                "bench/scheduler_bench.cpp",
+            ],
+            "include_dirs": ["./include"],
+            "defines": ["OVLLM_MOCK_BACKEND"],
+            "libraries": [
+                "..\\lib\\intel64\\Release\\openvino.lib",
+                "..\\lib\\intel64\\Release\\openvino_genai.lib",
+            ],
+        },
+        {
+            "target_name": "serving_bench",
+            "type": "executable",
+            "cflags!": ["-fno-exceptions"],
+            "cflags_cc!": ["-fno-exceptions"],
+            "sources": [
+                "arena.cpp",
+                "cpu_features.cpp",
+                "engine.cpp",
+                "grammar.cpp",
+                "logits_processor.cpp",
+                "metrics.cpp",
+                "model_transforms.cpp",
+                "profiler.cpp",
+                "sampler.cpp",
+                "scheduler.cpp",
+                "prompt_lookup.cpp",
+                "tracer.cpp",
+                "bench/serving_bench.cpp",
+            ],
+            "include_dirs": ["./include"],
+            "libraries": [
+                "..\\lib\\intel64\\Release\\openvino.lib",
+                "..\\lib\\intel64\\Release\\openvino_genai.lib",
+            ],
+        },
+        {
+            "target_name": "session_test",
+            "type": "executable",
+            "cflags!": ["-fno-exceptions"],
+            "cflags_cc!": ["-fno-exceptions"],
+            "sources": [
+                "arena.cpp",
+                "cpu_features.cpp",
+                "engine.cpp",
+                "grammar.cpp",
+                "logits_processor.cpp",
+                "metrics.cpp",
+                "model_transforms.cpp",
+                "profiler.cpp",
+                "sampler.cpp",
+                "prompt_lookup.cpp",
+                "tracer.cpp",
+                "test/session_test.cpp",
+            ],
+            "include_dirs": ["./include"],
+            "libraries": [
+                "..\\lib\\intel64\\Release\\openvino.lib",
+                "..\\lib\\intel64\\Release\\openvino_genai.lib",
+            ],
+        },
+        {
+            "target_name": "scheduler_test",
+            "type": "executable",
+            "cflags!": ["-fno-exceptions"],
+            "cflags_cc!": ["-fno-exceptions"],
+            "sources": [
+                "metrics.cpp",
+                "mock_backend.cpp",
+                "scheduler.cpp",
+                "tracer.cpp",
+                "test/scheduler_test.cpp",
+            ],
+            "include_dirs": ["./include"],
+            "defines": ["OVLLM_MOCK_BACKEND"],
+            "libraries": [
+                "..\\lib\\intel64\\Release\\openvino.lib",
+                "..\\lib\\intel64\\Release\\openvino_genai.lib",
+            ],
         }
     ]
 }
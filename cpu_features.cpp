@@ -0,0 +1,40 @@
+#include "cpu_features.hpp"
+
+#if defined(OVLLM_X86) && defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace ovllm
+{
+    static CpuFeatures detect()
+    {
+        CpuFeatures features;
+#if defined(OVLLM_X86) && defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        const int max_leaf = info[0];
+        __cpuid(info, 1);
+        // AVX state must be enabled by the OS in XCR0, ZMM and opmask state as well for AVX-512
+        if (max_leaf < 7 || !(info[2] & (1 << 27)))
+        {
+            return features;
+        }
+        const unsigned long long xcr0 = _xgetbv(0);
+        __cpuidex(info, 7, 0);
+        features.avx2 = (xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5));
+        features.avx512f = (xcr0 & 0xE6) == 0xE6 && (info[1] & (1 << 16));
+#elif defined(OVLLM_X86)
+        // Checks the OS support of the register state as well
+        __builtin_cpu_init();
+        features.avx2 = __builtin_cpu_supports("avx2");
+        features.avx512f = __builtin_cpu_supports("avx512f");
+#endif
+        return features;
+    }
+
+    const CpuFeatures &cpu_features()
+    {
+        static const CpuFeatures features = detect();
+        return features;
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+// Vector kernels are compiled per function for the instruction set they use and chosen at run time, the
+// rest of the addon keeps the baseline instruction set of the platform.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define OVLLM_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+// MSVC emits intrinsics of any instruction set without target options
+#define OVLLM_TARGET(isa)
+#else
+#define OVLLM_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace ovllm
+{
+    // Instruction sets of the CPU the process runs on, usable only when the OS also saves their registers.
+    struct CpuFeatures
+    {
+        bool avx2 = false;
+        bool avx512f = false;
+    };
+
+    // Detected on first use.
+    const CpuFeatures &cpu_features();
+}
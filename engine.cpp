@@ -0,0 +1,614 @@
+#include "engine.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+#include "openvino/op/util/gather_base.hpp"
+#include "openvino/op/util/read_value_base.hpp"
+#include "logits_processor.hpp"
+#include "metrics.hpp"
+#include "model_transforms.hpp"
+#include "prompt_lookup.hpp"
+#include "sampler.hpp"
+#include "tracer.hpp"
+
+namespace ovllm
+{
+    // Tokens decoded per detokenizer call when building the vocabulary
+    static constexpr size_t kVocabularyBatch = 8192;
+
+    static SamplerConfig sampler_config(const ov::genai::GenerationConfig &config)
+    {
+        SamplerConfig sampling;
+        sampling.do_sample = config.do_sample;
+        sampling.temperature = config.temperature;
+        sampling.top_k = config.top_k;
+        sampling.top_p = config.top_p;
+        sampling.repetition_penalty = config.repetition_penalty;
+        return sampling;
+    }
+
+    SequenceAxes sequence_axes(const ov::Model &model)
+    {
+        // Batch axes of the variables, from the Gather of each ReadValue by beam_idx
+        std::map<std::string, size_t> batch_axes;
+        for (const auto &node : model.get_ops())
+        {
+            auto read = std::dynamic_pointer_cast<ov::op::util::ReadValueBase>(node);
+            if (!read)
+            {
+                continue;
+            }
+            for (const ov::Input<ov::Node> &consumer : read->output(0).get_target_inputs())
+            {
+                auto gather = dynamic_cast<const ov::op::util::GatherBase *>(consumer.get_node());
+                if (gather != nullptr && consumer.get_index() == 0)
+                {
+                    batch_axes[read->get_variable_id()] = size_t(gather->get_axis());
+                }
+            }
+        }
+
+        SequenceAxes axes;
+        for (const auto &variable : model.get_variables())
+        {
+            const ov::op::util::VariableInfo &info = variable->get_info();
+            if (info.data_shape.rank().is_dynamic())
+            {
+                continue;
+            }
+            auto batch = batch_axes.find(info.variable_id);
+            std::vector<size_t> &candidates = axes[info.variable_id];
+            for (size_t axis = 0; axis < info.data_shape.size(); ++axis)
+            {
+                if (info.data_shape[axis].is_dynamic() && (batch == batch_axes.end() || batch->second != axis))
+                {
+                    candidates.push_back(axis);
+                }
+            }
+        }
+        return axes;
+    }
+
+    Session::Session(ov::InferRequest request, ov::Allocator allocator, SequenceAxes sequence_axes)
+        : m_request(std::move(request)), m_allocator(std::move(allocator)), m_sequence_axes(std::move(sequence_axes))
+    {
+        for (const auto &input : m_request.get_compiled_model().inputs())
+        {
+            m_has_position_ids |= input.get_names().count("position_ids") > 0;
+            m_has_beam_idx |= input.get_names().count("beam_idx") > 0;
+        }
+        for (const auto &output : m_request.get_compiled_model().outputs())
+        {
+            m_has_top_k |= output.get_names().count("top_k_indices") > 0;
+        }
+        if (m_has_beam_idx)
+        {
+            // One sequence per request, bound once
+            ov::Tensor beam_idx(ov::element::i32, {1}, m_allocator);
+            beam_idx.data<int32_t>()[0] = 0;
+            m_request.set_tensor("beam_idx", beam_idx);
+        }
+    }
+
+    bool Session::resize_input(const char *name, Input &input, size_t size)
+    {
+        bool grown = false;
+        if (size > input.capacity)
+        {
+            input.capacity = std::max(size, 2 * input.capacity);
+            input.buffer = ov::Tensor(ov::element::i64, {1, input.capacity}, m_allocator);
+            grown = true;
+        }
+        // A view never owns or reallocates memory, the buffer keeps its shape for the whole capacity
+        m_request.set_tensor(name, ov::Tensor(ov::element::i64, {1, size}, input.buffer.data<int64_t>()));
+        return grown;
+    }
+
+    Logits Session::forward(const int64_t *tokens, size_t count)
+    {
+        const size_t total = m_length + count;
+
+        // Inputs are rewritten in place, a step only allocates when a buffer outgrows its capacity
+        resize_input("input_ids", m_input_ids, count);
+        std::copy_n(tokens, count, m_input_ids.buffer.data<int64_t>());
+
+        if (resize_input("attention_mask", m_attention_mask, total))
+        {
+            // Filled once over the whole capacity of a new buffer, steps only bind longer views
+            std::fill_n(m_attention_mask.buffer.data<int64_t>(), m_attention_mask.capacity, 1);
+        }
+
+        if (m_has_position_ids)
+        {
+            resize_input("position_ids", m_position_ids, count);
+            int64_t *positions = m_position_ids.buffer.data<int64_t>();
+            std::iota(positions, positions + count, int64_t(m_length));
+        }
+
+        m_request.infer();
+        set_length(total);
+        Logits logits;
+        if (m_has_top_k)
+        {
+            logits.values = m_request.get_tensor("top_k_values");
+            logits.indices = m_request.get_tensor("top_k_indices");
+        }
+        else
+        {
+            logits.values = m_request.get_tensor("logits");
+        }
+        logits.offset = count - logits.values.get_shape()[1];
+        return logits;
+    }
+
+    void Session::trim(size_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        if (count > m_length)
+        {
+            throw std::out_of_range("Cannot trim more tokens than the KV cache holds");
+        }
+        const size_t length = m_length - count;
+        for (auto &state : m_request.query_state())
+        {
+            ov::Tensor cache = state.get_state();
+            ov::Shape shape = cache.get_shape();
+            auto candidates = m_sequence_axes.find(state.get_name());
+            if (candidates == m_sequence_axes.end())
+            {
+                throw std::runtime_error("KV cache " + state.get_name() + " is not a variable of the model");
+            }
+            // A batch axis that no Gather revealed stays a candidate, but with one sequence it has size 1, so
+            // only a length of 1 is ambiguous. The later axis is the sequence axis in supported layouts.
+            auto axis = std::find_if(candidates->second.rbegin(), candidates->second.rend(),
+                                     [&](size_t candidate) { return shape[candidate] == m_length; });
+            if (axis == candidates->second.rend())
+            {
+                throw std::runtime_error("Cannot find the sequence axis of KV cache " + state.get_name());
+            }
+            ov::Coordinate begin(shape.size(), 0);
+            ov::Coordinate end(shape);
+            end[*axis] = length;
+            shape[*axis] = length;
+
+            // get_state() can return the plugin's own memory, so the kept range is copied out first rather
+            // than set from a view that overlaps it
+            ov::Tensor trimmed(cache.get_element_type(), shape, m_allocator);
+            ov::Tensor(cache, begin, end).copy_to(trimmed);
+            state.set_state(trimmed);
+        }
+        set_length(length);
+    }
+
+    void Session::reset()
+    {
+        for (auto &state : m_request.query_state())
+        {
+            state.reset();
+        }
+        set_length(0);
+    }
+
+    size_t SessionSnapshot::bytes() const
+    {
+        size_t total = 0;
+        for (const auto &[name, tensor] : states)
+        {
+            total += tensor.get_byte_size();
+        }
+        return total;
+    }
+
+    SessionSnapshot Session::snapshot()
+    {
+        SessionSnapshot snapshot;
+        snapshot.length = m_length;
+        for (auto &state : m_request.query_state())
+        {
+            ov::Tensor cache = state.get_state();
+            ov::Tensor copy(cache.get_element_type(), cache.get_shape(), m_allocator);
+            cache.copy_to(copy);
+            snapshot.states.emplace_back(state.get_name(), std::move(copy));
+        }
+        return snapshot;
+    }
+
+    void Session::restore(const SessionSnapshot &snapshot)
+    {
+        for (auto &state : m_request.query_state())
+        {
+            auto found = std::find_if(snapshot.states.begin(), snapshot.states.end(),
+                                      [&](const auto &entry) { return entry.first == state.get_name(); });
+            if (found == snapshot.states.end())
+            {
+                throw std::runtime_error("Snapshot has no KV cache " + state.get_name());
+            }
+            state.set_state(found->second);
+        }
+        set_length(snapshot.length);
+    }
+
+    Session::~Session()
+    {
+        set_length(0);
+    }
+
+    void Session::set_length(size_t length)
+    {
+        if (m_position_bytes == 0 && length > 0)
+        {
+            size_t bytes = 0;
+            for (auto &state : m_request.query_state())
+            {
+                bytes += state.get_state().get_byte_size();
+            }
+            m_position_bytes = bytes / length;
+        }
+        metrics().kv_cache_bytes.fetch_add((int64_t(length) - int64_t(m_length)) * int64_t(m_position_bytes), std::memory_order_relaxed);
+        m_length = length;
+    }
+
+    // KV cache bytes per sequence position: the static dimensions of every state variable, which are
+    // [batch, kv heads, sequence, head size] for the models supported, in the precision the device
+    // keeps the cache in. 0 when a variable has no static shape beyond batch and sequence.
+    static size_t estimate_kv_bytes_per_token(const ov::Model &model, const ov::CompiledModel &compiled)
+    {
+        ov::element::Type precision;
+        try
+        {
+            precision = compiled.get_property(ov::hint::kv_cache_precision);
+        }
+        catch (const ov::Exception &)
+        {
+            // Devices without the hint keep the variables' own type
+        }
+        size_t bytes = 0;
+        for (const auto &variable : model.get_variables())
+        {
+            const ov::op::util::VariableInfo &info = variable->get_info();
+            size_t elements = 1;
+            size_t dynamic = 0;
+            for (const ov::Dimension &dimension : info.data_shape)
+            {
+                if (dimension.is_static())
+                {
+                    elements *= dimension.get_length();
+                }
+                else
+                {
+                    ++dynamic;
+                }
+            }
+            if (info.data_shape.rank().is_dynamic() || dynamic > 2)
+            {
+                return 0;
+            }
+            const ov::element::Type type = precision.is_static() ? precision : info.data_type;
+            bytes += elements * type.bitwidth() / 8;
+        }
+        return bytes;
+    }
+
+    Engine::Engine(const std::string &model_path, const std::string &device, const EngineOptions &options,
+                   const ov::AnyMap &plugin_config)
+        : m_options(options), m_tokenizer(model_path)
+    {
+        const Clock::time_point start = Clock::now();
+        std::shared_ptr<ov::Model> model = m_core.read_model(model_path + "/openvino_model.xml");
+        m_vocab_size = model->output("logits").get_partial_shape().rbegin()->get_length();
+        if (m_options.logits_positions != 0 && !slice_logits_positions(model, m_options.logits_positions))
+        {
+            m_options.logits_positions = 0;
+        }
+        if (m_options.graph_top_k != 0)
+        {
+            m_options.graph_top_k = std::min(m_options.graph_top_k, m_vocab_size);
+            append_top_k(model, m_options.graph_top_k);
+        }
+        ov::AnyMap compile_config = plugin_config;
+        if (m_options.profile_every != 0)
+        {
+            compile_config[ov::enable_profiling.name()] = true;
+            m_profiler = std::make_unique<Profiler>(m_options.profile_every);
+        }
+        m_compiled = m_core.compile_model(model, device, compile_config);
+        m_kv_bytes_per_token = estimate_kv_bytes_per_token(*model, m_compiled);
+        m_sequence_axes = sequence_axes(*model);
+        metrics().model_load_seconds.store(std::chrono::duration<double>(Clock::now() - start).count(), std::memory_order_relaxed);
+
+        const std::string config_path = model_path + "/generation_config.json";
+        if (std::filesystem::exists(config_path))
+        {
+            m_generation_config = ov::genai::GenerationConfig(config_path);
+        }
+        if (m_generation_config.eos_token_id == -1)
+        {
+            m_generation_config.eos_token_id = m_tokenizer.get_eos_token_id();
+        }
+    }
+
+    std::vector<int64_t> Engine::encode(const std::string &prompt)
+    {
+        ov::Tensor input_ids = m_tokenizer.encode(prompt).input_ids;
+        const int64_t *data = input_ids.data<int64_t>();
+        return std::vector<int64_t>(data, data + input_ids.get_size());
+    }
+
+    std::shared_ptr<const Vocabulary> Engine::vocabulary()
+    {
+        if (m_vocabulary)
+        {
+            return m_vocabulary;
+        }
+        const size_t size = vocab_size();
+        // Tokens are decoded after an anchor token, so that leading spaces which detokenizers drop
+        // at the start of a text are kept
+        const int64_t anchor = encode("a").back();
+        const std::string anchor_text = m_tokenizer.decode(std::vector<int64_t>{anchor});
+
+        std::vector<std::string> tokens;
+        tokens.reserve(size);
+        for (size_t first = 0; first < size; first += kVocabularyBatch)
+        {
+            std::vector<std::vector<int64_t>> batch;
+            for (size_t id = first; id < std::min(size, first + kVocabularyBatch); ++id)
+            {
+                batch.push_back({anchor, int64_t(id)});
+            }
+            for (std::string &text : m_tokenizer.decode(batch))
+            {
+                const bool anchored = text.compare(0, anchor_text.size(), anchor_text) == 0;
+                tokens.push_back(anchored ? text.substr(anchor_text.size()) : std::string());
+            }
+        }
+        m_vocabulary = std::make_shared<Vocabulary>(std::move(tokens));
+        return m_vocabulary;
+    }
+
+    std::shared_ptr<const TokenAutomaton> Engine::compile_grammar(const Pattern &pattern)
+    {
+        const Dfa dfa(pattern);
+        return std::make_shared<TokenAutomaton>(dfa, *vocabulary(), m_generation_config.eos_token_id, m_options.grammar_mask_budget);
+    }
+
+    Result Engine::generate(Session &session, const Request &request)
+    {
+        Generation generation(*this, session, request);
+        while (generation.step())
+        {
+        }
+        return std::move(generation.result());
+    }
+
+    static void validate(const Engine &engine, const Request &request)
+    {
+        const ov::genai::GenerationConfig &config = request.config;
+        if (request.prompt.empty())
+        {
+            throw std::invalid_argument("Prompt must contain at least one token");
+        }
+        if (!request.logit_bias.empty() && request.logit_bias.size() != engine.vocab_size())
+        {
+            throw std::invalid_argument("Logit bias must have an entry for every token");
+        }
+        const size_t graph_top_k = engine.graph_top_k();
+        if (graph_top_k != 0)
+        {
+            if (request.grammar || !request.logit_bias.empty() || config.repetition_penalty != 1.0f)
+            {
+                throw std::invalid_argument("Grammars, logit bias and repetition penalty need full logits, "
+                                            "the model was loaded with a graph top-k");
+            }
+            if (config.do_sample && (config.top_k == 0 || config.top_k > graph_top_k))
+            {
+                throw std::invalid_argument("Sampling with a graph top-k of " + std::to_string(graph_top_k) +
+                                            " needs topK between 1 and " + std::to_string(graph_top_k));
+            }
+        }
+    }
+
+    Generation::Generation(const Engine &engine, Session &session, Request request)
+        : m_engine(engine), m_session(&session), m_request(std::move(request)), m_context(m_request.prompt),
+          m_sampler(sampler_config(m_request.config), engine.vocab_size(), m_request.seed ? *m_request.seed : std::random_device{}())
+    {
+        validate(engine, m_request);
+        m_max_new_tokens = m_request.config.get_max_new_tokens(m_request.prompt.size());
+        m_result.stats.prompt_tokens = m_request.prompt.size();
+        for (int64_t token : m_request.prompt)
+        {
+            m_sampler.observe(token);
+        }
+        m_session->reset();
+        metrics().active_sessions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Generation::~Generation()
+    {
+        if (!suspended())
+        {
+            metrics().active_sessions.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    size_t Generation::suspend()
+    {
+        m_snapshot = m_session->snapshot();
+        m_session->reset();
+        m_session = nullptr;
+        metrics().active_sessions.fetch_sub(1, std::memory_order_relaxed);
+        return m_snapshot.bytes();
+    }
+
+    void Generation::resume(Session &session)
+    {
+        session.restore(m_snapshot);
+        m_session = &session;
+        m_snapshot = SessionSnapshot();
+        metrics().active_sessions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool Generation::step()
+    {
+        if (m_finished)
+        {
+            return false;
+        }
+        if (prefilling())
+        {
+            prefill();
+        }
+        else
+        {
+            decode();
+        }
+        m_result.stats.generated_tokens = m_result.tokens.size();
+        return !m_finished;
+    }
+
+    // Picks the token at a position of the logits, after the bias and the grammar mask of its current state.
+    // With prompt lookup, sampling each position and accepting a candidate only when it was drawn
+    // keeps the output distribution of plain sampling.
+    int64_t Generation::select(Logits &logits, size_t position)
+    {
+        const size_t vocab = logits.values.get_shape().back();
+        position -= logits.offset;
+        float *row = logits.values.data<float>() + position * vocab;
+        if (logits.indices)
+        {
+            // A graph top-k row holds the k best logits, their token ids sit in the indices
+            return m_sampler.sample_top(row, logits.indices.data<int32_t>() + position * vocab, vocab);
+        }
+        if (!m_request.logit_bias.empty())
+        {
+            add_logit_bias(row, m_request.logit_bias.data(), vocab);
+        }
+        if (m_request.grammar)
+        {
+            apply_token_mask(row, m_request.grammar->allowed(m_grammar_state), std::min(vocab, m_request.grammar->vocab_size()));
+        }
+        return m_sampler.sample(row);
+    }
+
+    // Returns true when generation has to stop after this token
+    bool Generation::emit(int64_t token)
+    {
+        const ov::genai::GenerationConfig &config = m_request.config;
+        if (!config.ignore_eos && token == config.eos_token_id)
+        {
+            return true;
+        }
+        if (m_request.grammar)
+        {
+            // Only a state whose mask allows nothing lets a disallowed token through, the grammar then ends
+            // without it
+            const uint32_t state = m_request.grammar->next(m_grammar_state, token);
+            if (state == Dfa::dead)
+            {
+                return true;
+            }
+            m_grammar_state = state;
+        }
+        m_result.tokens.push_back(token);
+        m_context.push_back(token);
+        m_sampler.observe(token);
+        if (m_request.on_token && m_request.on_token(token))
+        {
+            m_result.finish_reason = FinishReason::stop;
+            return true;
+        }
+        if (m_result.tokens.size() >= m_max_new_tokens)
+        {
+            m_result.finish_reason = FinishReason::length;
+            return true;
+        }
+        return false;
+    }
+
+    void Generation::prefill()
+    {
+        const std::vector<int64_t> &prompt = m_request.prompt;
+        const size_t chunk = m_engine.prefill_chunk();
+        const size_t count = chunk == 0 ? prompt.size() - m_prefilled : std::min(chunk, prompt.size() - m_prefilled);
+        trace::Span span("prefill_chunk", m_request.id);
+        Logits logits = m_session->forward(prompt.data() + m_prefilled, count);
+        ++m_result.stats.forward_passes;
+        profile(Profiler::Phase::prefill, span.begin());
+        m_prefilled += count;
+        if (prefilling())
+        {
+            return;
+        }
+        m_token = select(logits, count - 1);
+        if (m_max_new_tokens == 0)
+        {
+            m_result.finish_reason = FinishReason::length;
+            m_finished = true;
+            return;
+        }
+        m_finished = emit(m_token);
+    }
+
+    void Generation::decode()
+    {
+        GenerationStats &stats = m_result.stats;
+        m_input.assign(1, m_token);
+        if (m_request.prompt_lookup)
+        {
+            std::vector<int64_t> candidates = find_candidates(m_context, *m_request.prompt_lookup);
+            // Every verified pass yields one more token than it accepts, and needs logits at every input position
+            size_t limit = m_max_new_tokens - m_result.tokens.size() - 1;
+            if (m_engine.logits_positions() != 0)
+            {
+                limit = std::min(limit, m_engine.logits_positions() - 1);
+            }
+            candidates.resize(std::min(candidates.size(), limit));
+            m_input.insert(m_input.end(), candidates.begin(), candidates.end());
+        }
+        const size_t drafted = m_input.size() - 1;
+
+        // Verifies all candidates in one pass: position i predicts the token following input[i]
+        trace::Span span("decode_step", m_request.id);
+        Logits logits = m_session->forward(m_input.data(), m_input.size());
+        ++stats.forward_passes;
+        profile(Profiler::Phase::decode, span.begin());
+        stats.draft_tokens += drafted;
+
+        size_t accepted = 0;
+        for (size_t i = 0; i <= drafted; ++i)
+        {
+            m_token = select(logits, i);
+            const bool matched = i < drafted && m_token == m_input[i + 1];
+            accepted += matched;
+            m_finished = emit(m_token);
+            if (m_finished || !matched)
+            {
+                break;
+            }
+        }
+        stats.accepted_tokens += accepted;
+        // Only the last token and the accepted candidates stay in the KV cache
+        m_session->trim(drafted - accepted);
+    }
+
+    void Generation::profile(Profiler::Phase phase, std::chrono::steady_clock::time_point begin)
+    {
+        Profiler *profiler = m_engine.profiler();
+        if (profiler == nullptr || !profiler->sample(phase))
+        {
+            return;
+        }
+        const std::vector<ov::ProfilingInfo> nodes = m_session->profiling_info();
+        profiler->add(phase, nodes);
+        if (trace::enabled() && begin != std::chrono::steady_clock::time_point())
+        {
+            trace::record_nodes(begin, nodes, m_request.id);
+        }
+    }
+}
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "openvino/openvino.hpp"
+#include "openvino/genai/generation_config.hpp"
+#include "openvino/genai/tokenizer.hpp"
+#include "arena.hpp"
+#include "grammar.hpp"
+#include "profiler.hpp"
+#include "sampler.hpp"
+
+namespace ovllm
+{
+    // Draft-free speculative decoding: candidates are copied from earlier context by n-gram match.
+    struct PromptLookupConfig
+    {
+        size_t max_ngram_size = 3;
+        size_t num_candidates = 5;
+    };
+
+    struct GenerationStats
+    {
+        size_t prompt_tokens = 0;
+        size_t generated_tokens = 0;
+        size_t forward_passes = 0;
+        size_t draft_tokens = 0;
+        size_t accepted_tokens = 0;
+    };
+
+    struct Request
+    {
+        std::vector<int64_t> prompt;
+        ov::genai::GenerationConfig config;
+        std::optional<PromptLookupConfig> prompt_lookup;
+        // Constrains generated text to a grammar by masking logits of disallowed tokens
+        std::shared_ptr<const TokenAutomaton> grammar;
+        // Dense bias added to the logits of every step, vocab_size() entries or empty
+        std::vector<float> logit_bias;
+        // Seeds the sampler, a random seed is used when unset
+        std::optional<uint64_t> seed;
+        // Called for every generated token, returns true to stop generation.
+        std::function<bool(int64_t)> on_token;
+        // Ties the spans of this request together in traces, 0 when untracked
+        uint64_t id = 0;
+        // Tenant whose share and rate limit the scheduler applies, empty for the default tenant
+        std::string tenant;
+        // The scheduler admits higher priorities first and preempts running generations of lower
+        // priority for them
+        int priority = 0;
+    };
+
+    enum class FinishReason
+    {
+        // End of sequence token, or the end of a grammar
+        eos,
+        // max_new_tokens reached
+        length,
+        // Stopped by the token callback: a stop string or the caller
+        stop,
+        error,
+    };
+
+    struct Result
+    {
+        std::vector<int64_t> tokens;
+        GenerationStats stats;
+        FinishReason finish_reason = FinishReason::eos;
+    };
+
+    struct EngineOptions
+    {
+        // Appends a TopK of this size to the logits output at load, 0 keeps full logits
+        size_t graph_top_k = 0;
+        // Computes logits for this many positions from the end of each forward pass, 0 keeps every
+        // position (prompt logprobs). Bounds the candidates of a prompt lookup verification.
+        size_t logits_positions = 16;
+
+        // Prompt tokens per prefill forward pass, 0 runs the whole prompt in one pass
+        size_t prefill_chunk = 512;
+        // Bytes the token masks of one compiled grammar may take, one vocabulary bitset per DFA state
+        size_t grammar_mask_budget = size_t(256) << 20;
+        // Compiles with profiling and collects node timings of one in this many forward passes
+        // per phase, 0 disables profiling
+        size_t profile_every = 0;
+    };
+
+    // Output of a forward pass, one row per input token.
+    struct Logits
+    {
+        // [1, count, vocab] logits, or [1, count, k] values sorted descending with a graph top-k
+        ov::Tensor values;
+        // [1, count, k] i32 token ids of the values, empty without a graph top-k
+        ov::Tensor indices;
+        // Input position of the first row, rows of earlier positions are sliced off in the graph
+        size_t offset = 0;
+    };
+
+    // KV cache of a sequence copied out of its session, to continue the sequence on any session of
+    // the same model.
+    struct SessionSnapshot
+    {
+        std::vector<std::pair<std::string, ov::Tensor>> states;
+        size_t length = 0;
+        size_t bytes() const;
+    };
+
+    // Candidate sequence axes of each KV cache variable by variable id.
+    using SequenceAxes = std::map<std::string, std::vector<size_t>>;
+
+    // The dynamic dimensions of each variable other than its batch axis, which is the axis the state is
+    // gathered on by beam_idx. Layouts differ, [batch, heads, sequence, head size] for most models and
+    // [sequence, batch, heads, head size] for ChatGLM, so trim() picks the candidate whose size is the
+    // current length.
+    SequenceAxes sequence_axes(const ov::Model &model);
+
+    // Decoding state (KV cache) of one sequence over an InferRequest of the stateful model.
+    class Session
+    {
+    public:
+        // Input buffers, trimmed KV caches and snapshots are allocated with allocator. trim() needs the
+        // sequence axes of the model's variables.
+        explicit Session(ov::InferRequest request, ov::Allocator allocator = {}, SequenceAxes sequence_axes = {});
+
+        // Appends tokens to the sequence and returns logits of the last of them.
+        Logits forward(const int64_t *tokens, size_t count);
+        // Drops the last count positions from the KV cache.
+        void trim(size_t count);
+        void reset();
+        // Copies the KV cache out, the session can then be reset for another sequence.
+        SessionSnapshot snapshot();
+        // Replaces the KV cache with a snapshot.
+        void restore(const SessionSnapshot &snapshot);
+        size_t length() const { return m_length; }
+        // Node timings of the last forward pass, when the model is compiled with profiling.
+        std::vector<ov::ProfilingInfo> profiling_info() const { return m_request.get_profiling_info(); }
+        ~Session();
+
+    private:
+        // Keeps the KV cache size gauge in step with the sequence length
+        void set_length(size_t length);
+        // An i64 input, bound as [1, n] views over an arena buffer of capacity elements
+        struct Input
+        {
+            ov::Tensor buffer;
+            size_t capacity = 0;
+        };
+
+        // Binds a [1, size] view of the input's buffer to the request. The buffer is replaced only when
+        // it is too small, with double the capacity. Returns true for a new buffer, whose contents are
+        // undefined.
+        bool resize_input(const char *name, Input &input, size_t size);
+
+        ov::InferRequest m_request;
+        ov::Allocator m_allocator;
+        SequenceAxes m_sequence_axes;
+        // Bound inputs, reused across steps and requests
+        Input m_input_ids;
+        Input m_attention_mask;
+        Input m_position_ids;
+        size_t m_length = 0;
+        // KV cache bytes per position over all states, measured after the first forward pass
+        size_t m_position_bytes = 0;
+        bool m_has_position_ids = false;
+        bool m_has_beam_idx = false;
+        bool m_has_top_k = false;
+    };
+
+    class Engine;
+
+    // One request decoded on a session a forward pass at a time: prefill chunks, then decode or
+    // prompt lookup verification steps. A scheduler interleaves the steps of several generations.
+    class Generation
+    {
+    public:
+        // Resets the session, throws for requests the engine cannot run.
+        Generation(const Engine &engine, Session &session, Request request);
+        Generation(const Generation &) = delete;
+        Generation &operator=(const Generation &) = delete;
+        ~Generation();
+
+        // Runs the next forward pass, returns false once generation has finished.
+        bool step();
+        // Moves the sequence off its session between steps, the session is free for others afterwards.
+        // Returns the bytes of the snapshot held.
+        size_t suspend();
+        // Continues on a session from the snapshot taken by suspend(), without prefilling again.
+        void resume(Session &session);
+        bool suspended() const { return m_session == nullptr; }
+        bool finished() const { return m_finished; }
+        bool prefilling() const { return m_prefilled < m_request.prompt.size(); }
+        Result &result() { return m_result; }
+
+    private:
+        int64_t select(Logits &logits, size_t position);
+        bool emit(int64_t token);
+        void prefill();
+        void decode();
+        // Profiles the forward pass that began at begin when the profiler samples it.
+        void profile(Profiler::Phase phase, std::chrono::steady_clock::time_point begin);
+
+        const Engine &m_engine;
+        // Null while suspended
+        Session *m_session;
+        SessionSnapshot m_snapshot;
+        Request m_request;
+        size_t m_max_new_tokens = 0;
+        Result m_result;
+        // Prompt and generated tokens, the search space of prompt lookup
+        std::vector<int64_t> m_context;
+        Sampler m_sampler;
+        uint32_t m_grammar_state = 0;
+        size_t m_prefilled = 0;
+        // Last selected token, the first input of the next decode step
+        int64_t m_token = 0;
+        std::vector<int64_t> m_input;
+        bool m_finished = false;
+    };
+
+    // Owns the compiled stateful LLM and tokenizer of a model directory.
+    class Engine
+    {
+    public:
+        Engine(const std::string &model_path, const std::string &device, const EngineOptions &options = {},
+               const ov::AnyMap &plugin_config = {});
+
+        ov::InferRequest create_request() { return m_compiled.create_infer_request(); }
+        // A session on a new InferRequest, allocating from the engine's arena.
+        std::unique_ptr<Session> create_session() { return std::make_unique<Session>(create_request(), allocator(), m_sequence_axes); }
+        // Allocator of the tensors the addon creates for this model.
+        ov::Allocator allocator() const { return ArenaAllocator{m_arena}; }
+        ov::genai::Tokenizer &tokenizer() { return m_tokenizer; }
+        const ov::genai::GenerationConfig &generation_config() const { return m_generation_config; }
+
+        std::vector<int64_t> encode(const std::string &prompt);
+        // Width of the logits, which can exceed the tokenizer vocabulary because of padding.
+        size_t vocab_size() const { return m_vocab_size; }
+        // Size of the graph top-k, 0 when the model returns full logits.
+        size_t graph_top_k() const { return m_options.graph_top_k; }
+        // Positions with logits per forward pass, 0 when all have them.
+        size_t logits_positions() const { return m_options.logits_positions; }
+        size_t prefill_chunk() const { return m_options.prefill_chunk; }
+        // Estimated KV cache bytes per sequence position from the layer count, KV heads, head size and
+        // cache precision of the model, 0 when the state shapes are not static enough to tell.
+        size_t kv_bytes_per_token() const { return m_kv_bytes_per_token; }
+        // Null unless profiling is enabled.
+        Profiler *profiler() const { return m_profiler.get(); }
+        // Runs a request to completion on the session.
+        Result generate(Session &session, const Request &request);
+
+        // Token strings indexed by id over the model's logits width, decoded on first use.
+        std::shared_ptr<const Vocabulary> vocabulary();
+        std::shared_ptr<const TokenAutomaton> compile_grammar(const Pattern &pattern);
+
+    private:
+        EngineOptions m_options;
+        std::shared_ptr<Arena> m_arena = std::make_shared<Arena>();
+        size_t m_vocab_size = 0;
+        size_t m_kv_bytes_per_token = 0;
+        SequenceAxes m_sequence_axes;
+        ov::Core m_core;
+        ov::CompiledModel m_compiled;
+        ov::genai::Tokenizer m_tokenizer;
+        ov::genai::GenerationConfig m_generation_config;
+        std::shared_ptr<const Vocabulary> m_vocabulary;
+        std::unique_ptr<Profiler> m_profiler;
+    };
+}
@@ -0,0 +1,747 @@
+#include "grammar.hpp"
+
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <stdexcept>
+
+namespace ovllm
+{
+    Pattern Pattern::byte_set(const std::bitset<256> &bytes)
+    {
+        Pattern pattern;
+        pattern.kind = Kind::Bytes;
+        pattern.bytes = bytes;
+        return pattern;
+    }
+
+    Pattern Pattern::literal(const std::string &text)
+    {
+        std::vector<Pattern> children;
+        for (unsigned char byte : text)
+        {
+            std::bitset<256> bytes;
+            bytes.set(byte);
+            children.push_back(byte_set(bytes));
+        }
+        return sequence(std::move(children));
+    }
+
+    Pattern Pattern::sequence(std::vector<Pattern> children)
+    {
+        if (children.size() == 1)
+        {
+            return std::move(children.front());
+        }
+        Pattern pattern;
+        pattern.kind = Kind::Sequence;
+        pattern.children = std::move(children);
+        return pattern;
+    }
+
+    Pattern Pattern::choice(std::vector<Pattern> children)
+    {
+        if (children.size() == 1)
+        {
+            return std::move(children.front());
+        }
+        Pattern pattern;
+        pattern.kind = Kind::Choice;
+        pattern.children = std::move(children);
+        return pattern;
+    }
+
+    Pattern Pattern::repeat(Pattern child, size_t min, size_t max)
+    {
+        if (max < min)
+        {
+            throw std::invalid_argument("Repetition upper bound is below its lower bound");
+        }
+        Pattern pattern;
+        pattern.kind = Kind::Repeat;
+        pattern.children.push_back(std::move(child));
+        pattern.min = min;
+        pattern.max = max;
+        return pattern;
+    }
+
+    static std::bitset<256> byte_range(unsigned char first, unsigned char last)
+    {
+        std::bitset<256> bytes;
+        for (size_t byte = first; byte <= last; ++byte)
+        {
+            bytes.set(byte);
+        }
+        return bytes;
+    }
+
+    static Pattern optional(Pattern pattern)
+    {
+        return Pattern::repeat(std::move(pattern), 0, 1);
+    }
+
+    class RegexParser
+    {
+    public:
+        explicit RegexParser(const std::string &regex) : m_regex(regex) {}
+
+        Pattern parse()
+        {
+            Pattern pattern = alternation();
+            if (!done())
+            {
+                throw std::invalid_argument("Unbalanced ')' in regex at offset " + std::to_string(m_pos));
+            }
+            return pattern;
+        }
+
+    private:
+        bool done() const { return m_pos >= m_regex.size(); }
+        unsigned char peek() const { return m_regex[m_pos]; }
+
+        unsigned char take()
+        {
+            if (done())
+            {
+                throw std::invalid_argument("Unexpected end of regex");
+            }
+            return m_regex[m_pos++];
+        }
+
+        Pattern alternation()
+        {
+            std::vector<Pattern> options{sequence()};
+            while (!done() && peek() == '|')
+            {
+                take();
+                options.push_back(sequence());
+            }
+            return Pattern::choice(std::move(options));
+        }
+
+        Pattern sequence()
+        {
+            std::vector<Pattern> items;
+            while (!done() && peek() != '|' && peek() != ')')
+            {
+                items.push_back(quantified(atom()));
+            }
+            return Pattern::sequence(std::move(items));
+        }
+
+        Pattern quantified(Pattern pattern)
+        {
+            while (!done())
+            {
+                const unsigned char c = peek();
+                if (c == '*' || c == '+' || c == '?')
+                {
+                    take();
+                    pattern = Pattern::repeat(std::move(pattern), c == '+' ? 1 : 0, c == '?' ? 1 : Pattern::unbounded);
+                }
+                else if (c == '{')
+                {
+                    take();
+                    const size_t min = number();
+                    size_t max = min;
+                    if (peek() == ',')
+                    {
+                        take();
+                        max = peek() == '}' ? Pattern::unbounded : number();
+                    }
+                    if (take() != '}')
+                    {
+                        throw std::invalid_argument("Expected '}' in regex at offset " + std::to_string(m_pos - 1));
+                    }
+                    pattern = Pattern::repeat(std::move(pattern), min, max);
+                }
+                else
+                {
+                    break;
+                }
+            }
+            return pattern;
+        }
+
+        size_t number()
+        {
+            size_t value = 0;
+            size_t digits = 0;
+            while (!done() && peek() >= '0' && peek() <= '9')
+            {
+                value = value * 10 + (take() - '0');
+                ++digits;
+            }
+            if (digits == 0)
+            {
+                throw std::invalid_argument("Expected a repetition count in regex at offset " + std::to_string(m_pos));
+            }
+            return value;
+        }
+
+        Pattern atom()
+        {
+            const unsigned char c = take();
+            switch (c)
+            {
+            case '(':
+            {
+                if (!done() && peek() == '?')
+                {
+                    take();
+                    if (take() != ':')
+                    {
+                        throw std::invalid_argument("Only non-capturing (?:...) groups are supported in regex");
+                    }
+                }
+                Pattern pattern = alternation();
+                if (done() || take() != ')')
+                {
+                    throw std::invalid_argument("Unbalanced '(' in regex");
+                }
+                return pattern;
+            }
+            case '[':
+                return Pattern::byte_set(byte_class());
+            case '.':
+                return Pattern::byte_set(~byte_range('\n', '\n'));
+            case '^':
+            case '$':
+                // Generated text is always matched as a whole
+                return Pattern::sequence({});
+            case '\\':
+                return Pattern::byte_set(escape());
+            default:
+                return Pattern::byte_set(byte_range(c, c));
+            }
+        }
+
+        std::bitset<256> escape()
+        {
+            const unsigned char c = take();
+            const std::bitset<256> digits = byte_range('0', '9');
+            const std::bitset<256> word = byte_range('a', 'z') | byte_range('A', 'Z') | digits | byte_range('_', '_');
+            const std::bitset<256> space = byte_range('\t', '\r') | byte_range(' ', ' ');
+            switch (c)
+            {
+            case 'd':
+                return digits;
+            case 'D':
+                return ~digits;
+            case 'w':
+                return word;
+            case 'W':
+                return ~word;
+            case 's':
+                return space;
+            case 'S':
+                return ~space;
+            case 'n':
+                return byte_range('\n', '\n');
+            case 't':
+                return byte_range('\t', '\t');
+            case 'r':
+                return byte_range('\r', '\r');
+            case 'f':
+                return byte_range('\f', '\f');
+            case 'v':
+                return byte_range('\v', '\v');
+            case 'x':
+            {
+                const std::string hex = {char(take()), char(take())};
+                const unsigned char byte = static_cast<unsigned char>(std::stoi(hex, nullptr, 16));
+                return byte_range(byte, byte);
+            }
+            default:
+                return byte_range(c, c);
+            }
+        }
+
+        // Single byte of a class, or a whole set for class escapes such as \d
+        std::bitset<256> class_item()
+        {
+            const unsigned char c = take();
+            return c == '\\' ? escape() : byte_range(c, c);
+        }
+
+        static unsigned char single_byte(const std::bitset<256> &bytes)
+        {
+            if (bytes.count() != 1)
+            {
+                throw std::invalid_argument("Character class escapes cannot bound a range");
+            }
+            size_t byte = 0;
+            while (!bytes.test(byte))
+            {
+                ++byte;
+            }
+            return static_cast<unsigned char>(byte);
+        }
+
+        std::bitset<256> byte_class()
+        {
+            const bool negate = !done() && peek() == '^';
+            if (negate)
+            {
+                take();
+            }
+            std::bitset<256> bytes;
+            bool first = true;
+            while (first || peek() != ']')
+            {
+                first = false;
+                std::bitset<256> item = class_item();
+                if (!done() && peek() == '-' && m_pos + 1 < m_regex.size() && m_regex[m_pos + 1] != ']')
+                {
+                    take();
+                    const unsigned char low = single_byte(item);
+                    const unsigned char high = single_byte(class_item());
+                    if (high < low)
+                    {
+                        throw std::invalid_argument("Invalid range in regex character class");
+                    }
+                    item = byte_range(low, high);
+                }
+                bytes |= item;
+                if (done())
+                {
+                    throw std::invalid_argument("Unterminated character class in regex");
+                }
+            }
+            take();
+            return negate ? ~bytes : bytes;
+        }
+
+        const std::string &m_regex;
+        size_t m_pos = 0;
+    };
+
+    Pattern parse_regex(const std::string &regex)
+    {
+        return RegexParser(regex).parse();
+    }
+
+    static Pattern json_whitespace()
+    {
+        return optional(Pattern::literal(" "));
+    }
+
+    static Pattern json_string()
+    {
+        // Any byte but '"', '\' and control characters, or an escape sequence
+        std::bitset<256> plain = ~byte_range(0x00, 0x1F);
+        plain.reset('"');
+        plain.reset('\\');
+        std::bitset<256> escaped;
+        for (unsigned char c : std::string("\"\\/bfnrt"))
+        {
+            escaped.set(c);
+        }
+        const std::bitset<256> hex = byte_range('0', '9') | byte_range('a', 'f') | byte_range('A', 'F');
+        Pattern character = Pattern::choice({
+            Pattern::byte_set(plain),
+            Pattern::sequence({Pattern::literal("\\"), Pattern::byte_set(escaped)}),
+            Pattern::sequence({Pattern::literal("\\u"), Pattern::repeat(Pattern::byte_set(hex), 4, 4)}),
+        });
+        return Pattern::sequence({Pattern::literal("\""), Pattern::repeat(std::move(character), 0), Pattern::literal("\"")});
+    }
+
+    static Pattern json_integer()
+    {
+        // Bounded digit runs, a model cannot get stuck extending a number
+        Pattern digits = Pattern::sequence({Pattern::byte_set(byte_range('1', '9')), Pattern::repeat(Pattern::byte_set(byte_range('0', '9')), 0, 15)});
+        return Pattern::sequence({optional(Pattern::literal("-")), Pattern::choice({Pattern::literal("0"), std::move(digits)})});
+    }
+
+    static Pattern json_number()
+    {
+        Pattern fraction = Pattern::sequence({Pattern::literal("."), Pattern::repeat(Pattern::byte_set(byte_range('0', '9')), 1, 15)});
+        std::bitset<256> e;
+        e.set('e');
+        e.set('E');
+        std::bitset<256> sign;
+        sign.set('+');
+        sign.set('-');
+        Pattern exponent = Pattern::sequence({Pattern::byte_set(e), optional(Pattern::byte_set(sign)), Pattern::repeat(Pattern::byte_set(byte_range('0', '9')), 1, 3)});
+        return Pattern::sequence({json_integer(), optional(std::move(fraction)), optional(std::move(exponent))});
+    }
+
+    static std::string json_quote(const std::string &text)
+    {
+        std::string quoted = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                quoted += '\\';
+            }
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    Pattern pattern_from_json_schema(const JsonSchema &schema)
+    {
+        if (!schema.enum_values.empty())
+        {
+            std::vector<Pattern> values;
+            for (const std::string &value : schema.enum_values)
+            {
+                values.push_back(Pattern::literal(value));
+            }
+            return Pattern::choice(std::move(values));
+        }
+        if (!schema.any_of.empty())
+        {
+            std::vector<Pattern> options;
+            for (const JsonSchema &option : schema.any_of)
+            {
+                options.push_back(pattern_from_json_schema(option));
+            }
+            return Pattern::choice(std::move(options));
+        }
+
+        const std::string &type = schema.type;
+        if (type == "string")
+        {
+            if (schema.pattern.empty())
+            {
+                return json_string();
+            }
+            return Pattern::sequence({Pattern::literal("\""), parse_regex(schema.pattern), Pattern::literal("\"")});
+        }
+        if (type == "integer")
+        {
+            return json_integer();
+        }
+        if (type == "number")
+        {
+            return json_number();
+        }
+        if (type == "boolean")
+        {
+            return Pattern::choice({Pattern::literal("true"), Pattern::literal("false")});
+        }
+        if (type == "null")
+        {
+            return Pattern::literal("null");
+        }
+        if (type == "object")
+        {
+            std::vector<Pattern> items{Pattern::literal("{"), json_whitespace()};
+            for (size_t i = 0; i < schema.properties.size(); ++i)
+            {
+                if (i > 0)
+                {
+                    items.push_back(Pattern::literal(","));
+                    items.push_back(json_whitespace());
+                }
+                items.push_back(Pattern::literal(json_quote(schema.properties[i].first)));
+                items.push_back(Pattern::literal(":"));
+                items.push_back(json_whitespace());
+                items.push_back(pattern_from_json_schema(schema.properties[i].second));
+            }
+            items.push_back(json_whitespace());
+            items.push_back(Pattern::literal("}"));
+            return Pattern::sequence(std::move(items));
+        }
+        if (type == "array")
+        {
+            if (!schema.items)
+            {
+                throw std::invalid_argument("JSON schema arrays need an items schema");
+            }
+            if (schema.max_items == 0)
+            {
+                return Pattern::literal("[]");
+            }
+            Pattern rest = Pattern::repeat(
+                Pattern::sequence({Pattern::literal(","), json_whitespace(), pattern_from_json_schema(*schema.items)}),
+                schema.min_items > 0 ? schema.min_items - 1 : 0,
+                schema.max_items == Pattern::unbounded ? Pattern::unbounded : schema.max_items - 1);
+            Pattern elements = Pattern::sequence({pattern_from_json_schema(*schema.items), std::move(rest)});
+            if (schema.min_items == 0)
+            {
+                elements = optional(std::move(elements));
+            }
+            return Pattern::sequence({Pattern::literal("["), json_whitespace(), std::move(elements), json_whitespace(), Pattern::literal("]")});
+        }
+        throw std::invalid_argument("Unsupported JSON schema type '" + type + "'");
+    }
+
+    // Thompson construction, every state has at most one byte edge
+    class Nfa
+    {
+    public:
+        static constexpr uint32_t none = uint32_t(-1);
+
+        struct State
+        {
+            std::vector<uint32_t> epsilon;
+            std::bitset<256> bytes;
+            uint32_t target = none;
+        };
+
+        explicit Nfa(const Pattern &pattern)
+        {
+            auto fragment = build(pattern);
+            m_start = fragment.first;
+            m_accept = fragment.second;
+        }
+
+        const State &state(uint32_t id) const { return m_states[id]; }
+        uint32_t start() const { return m_start; }
+        uint32_t accept() const { return m_accept; }
+
+    private:
+        uint32_t add()
+        {
+            m_states.emplace_back();
+            return static_cast<uint32_t>(m_states.size() - 1);
+        }
+
+        void link(uint32_t from, uint32_t to)
+        {
+            m_states[from].epsilon.push_back(to);
+        }
+
+        std::pair<uint32_t, uint32_t> build(const Pattern &pattern)
+        {
+            const uint32_t start = add();
+            const uint32_t end = add();
+            switch (pattern.kind)
+            {
+            case Pattern::Kind::Bytes:
+                m_states[start].bytes = pattern.bytes;
+                m_states[start].target = end;
+                break;
+            case Pattern::Kind::Sequence:
+            {
+                uint32_t last = start;
+                for (const Pattern &child : pattern.children)
+                {
+                    auto fragment = build(child);
+                    link(last, fragment.first);
+                    last = fragment.second;
+                }
+                link(last, end);
+                break;
+            }
+            case Pattern::Kind::Choice:
+                for (const Pattern &child : pattern.children)
+                {
+                    auto fragment = build(child);
+                    link(start, fragment.first);
+                    link(fragment.second, end);
+                }
+                break;
+            case Pattern::Kind::Repeat:
+            {
+                const Pattern &child = pattern.children.front();
+                uint32_t last = start;
+                for (size_t i = 0; i < pattern.min; ++i)
+                {
+                    auto fragment = build(child);
+                    link(last, fragment.first);
+                    last = fragment.second;
+                }
+                if (pattern.max == Pattern::unbounded)
+                {
+                    auto fragment = build(child);
+                    link(last, fragment.first);
+                    link(fragment.second, fragment.first);
+                    link(fragment.second, end);
+                }
+                else
+                {
+                    for (size_t i = pattern.min; i < pattern.max; ++i)
+                    {
+                        auto fragment = build(child);
+                        link(last, fragment.first);
+                        link(last, end);
+                        last = fragment.second;
+                    }
+                }
+                link(last, end);
+                break;
+            }
+            }
+            return {start, end};
+        }
+
+        std::vector<State> m_states;
+        uint32_t m_start = none;
+        uint32_t m_accept = none;
+    };
+
+    static constexpr size_t kMaxDfaStates = 65536;
+
+    Dfa::Dfa(const Pattern &pattern)
+    {
+        const Nfa nfa(pattern);
+
+        auto closure = [&nfa](std::vector<uint32_t> states)
+        {
+            std::vector<uint32_t> stack = states;
+            while (!stack.empty())
+            {
+                const uint32_t id = stack.back();
+                stack.pop_back();
+                for (uint32_t next : nfa.state(id).epsilon)
+                {
+                    if (std::find(states.begin(), states.end(), next) == states.end())
+                    {
+                        states.push_back(next);
+                        stack.push_back(next);
+                    }
+                }
+            }
+            std::sort(states.begin(), states.end());
+            return states;
+        };
+
+        // Subset construction
+        std::map<std::vector<uint32_t>, uint32_t> ids;
+        std::vector<std::vector<uint32_t>> subsets{closure({nfa.start()})};
+        ids.emplace(subsets.front(), 0);
+        for (size_t current = 0; current < subsets.size(); ++current)
+        {
+            m_transitions.resize((current + 1) * 256, dead);
+            const std::vector<uint32_t> subset = subsets[current];
+            m_accepting.push_back(std::binary_search(subset.begin(), subset.end(), nfa.accept()));
+            for (size_t byte = 0; byte < 256; ++byte)
+            {
+                std::vector<uint32_t> targets;
+                for (uint32_t id : subset)
+                {
+                    const Nfa::State &state = nfa.state(id);
+                    if (state.target != Nfa::none && state.bytes.test(byte))
+                    {
+                        targets.push_back(state.target);
+                    }
+                }
+                if (targets.empty())
+                {
+                    continue;
+                }
+                targets = closure(std::move(targets));
+                auto found = ids.find(targets);
+                if (found == ids.end())
+                {
+                    if (subsets.size() >= kMaxDfaStates)
+                    {
+                        throw std::invalid_argument("Grammar is too large to compile");
+                    }
+                    found = ids.emplace(targets, static_cast<uint32_t>(subsets.size())).first;
+                    subsets.push_back(targets);
+                }
+                m_transitions[current * 256 + byte] = found->second;
+            }
+        }
+    }
+
+    Vocabulary::Vocabulary(std::vector<std::string> tokens) : tokens(std::move(tokens))
+    {
+        order.resize(this->tokens.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            order[i] = static_cast<int32_t>(i);
+        }
+        std::sort(order.begin(), order.end(), [this](int32_t a, int32_t b)
+                  { return this->tokens[a] < this->tokens[b]; });
+
+        common_prefix.resize(order.size(), 0);
+        for (size_t i = 1; i < order.size(); ++i)
+        {
+            const std::string &previous = this->tokens[order[i - 1]];
+            const std::string &current = this->tokens[order[i]];
+            const size_t limit = std::min(previous.size(), current.size());
+            size_t length = 0;
+            while (length < limit && previous[length] == current[length])
+            {
+                ++length;
+            }
+            common_prefix[i] = static_cast<uint32_t>(length);
+        }
+    }
+
+    // Words of the mask table, checked against the budget before it is allocated
+    static size_t mask_words(size_t states, size_t words, size_t max_bytes)
+    {
+        const size_t bytes = states * words * sizeof(uint64_t);
+        if (bytes > max_bytes)
+        {
+            throw std::length_error("Grammar needs " + std::to_string((bytes + (1 << 20) - 1) >> 20) + " MiB of token masks for " +
+                                    std::to_string(states) + " states, more than the budget of " + std::to_string(max_bytes >> 20) +
+                                    " MiB. Simplify the schema or raise grammarMaskBudgetMb");
+        }
+        return states * words;
+    }
+
+    TokenAutomaton::TokenAutomaton(const Dfa &dfa, const Vocabulary &vocabulary, int64_t eos_token_id, size_t max_mask_bytes)
+        : m_vocab_size(vocabulary.tokens.size()),
+          m_words((vocabulary.tokens.size() + 63) / 64),
+          m_eos_token_id(eos_token_id),
+          m_masks(mask_words(dfa.size(), m_words, max_mask_bytes), 0),
+          m_transitions(dfa.size())
+    {
+        static constexpr size_t alive = size_t(-1);
+        for (uint32_t state = 0; state < dfa.size(); ++state)
+        {
+            m_accepting.push_back(dfa.accepting(state));
+            uint64_t *mask = m_masks.data() + state * m_words;
+            // path[d] is the DFA state after the first d bytes of the current token. Tokens are
+            // visited in sorted order, so each walk resumes from the prefix shared with the previous
+            // token, and tokens sharing a prefix that already left the language are skipped.
+            std::vector<uint32_t> path{state};
+            size_t dead_at = alive;
+            for (size_t i = 0; i < vocabulary.order.size(); ++i)
+            {
+                const int32_t token = vocabulary.order[i];
+                const std::string &text = vocabulary.tokens[token];
+                const size_t shared = vocabulary.common_prefix[i];
+                if (text.empty() || (dead_at != alive && shared >= dead_at))
+                {
+                    continue;
+                }
+                dead_at = alive;
+                path.resize(shared + 1);
+                for (size_t d = shared; d < text.size(); ++d)
+                {
+                    const uint32_t next = dfa.next(path.back(), static_cast<unsigned char>(text[d]));
+                    if (next == Dfa::dead)
+                    {
+                        dead_at = d + 1;
+                        break;
+                    }
+                    path.push_back(next);
+                }
+                if (dead_at == alive)
+                {
+                    mask[token / 64] |= uint64_t(1) << (token % 64);
+                    m_transitions[state].emplace_back(token, path.back());
+                }
+            }
+            std::sort(m_transitions[state].begin(), m_transitions[state].end());
+            if (dfa.accepting(state) && eos_token_id >= 0 && size_t(eos_token_id) < m_vocab_size)
+            {
+                mask[eos_token_id / 64] |= uint64_t(1) << (eos_token_id % 64);
+            }
+        }
+    }
+
+    uint32_t TokenAutomaton::next(uint32_t state, int64_t token) const
+    {
+        if (token == m_eos_token_id)
+        {
+            return state;
+        }
+        const auto &transitions = m_transitions[state];
+        auto found = std::lower_bound(transitions.begin(), transitions.end(), std::make_pair(static_cast<int32_t>(token), uint32_t(0)));
+        if (found == transitions.end() || found->first != token)
+        {
+            return Dfa::dead;
+        }
+        return found->second;
+    }
+}
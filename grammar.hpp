@@ -0,0 +1,112 @@
+#pragma once
+
+#include <bitset>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ovllm
+{
+    // Regular expression tree over bytes, the common form of regex and JSON schema grammars.
+    struct Pattern
+    {
+        enum class Kind
+        {
+            Bytes,
+            Sequence,
+            Choice,
+            Repeat
+        };
+        static constexpr size_t unbounded = size_t(-1);
+
+        Kind kind = Kind::Sequence;
+        std::bitset<256> bytes;
+        std::vector<Pattern> children;
+        size_t min = 0;
+        size_t max = unbounded;
+
+        static Pattern byte_set(const std::bitset<256> &bytes);
+        static Pattern literal(const std::string &text);
+        static Pattern sequence(std::vector<Pattern> children);
+        static Pattern choice(std::vector<Pattern> children);
+        static Pattern repeat(Pattern child, size_t min, size_t max = unbounded);
+    };
+
+    // Parses a regular expression: literals, escapes (\d \w \s \xHH and escaped metacharacters),
+    // classes with ranges and negation, groups, alternation and the * + ? {n} {n,} {n,m} quantifiers.
+    Pattern parse_regex(const std::string &regex);
+
+    // Subset of JSON schema that compiles to a regular language.
+    struct JsonSchema
+    {
+        // object, array, string, number, integer, boolean or null, empty when only enum/any_of is set
+        std::string type;
+        std::vector<std::pair<std::string, JsonSchema>> properties;
+        std::shared_ptr<JsonSchema> items;
+        size_t min_items = 0;
+        size_t max_items = Pattern::unbounded;
+        // JSON encoded literals of enum/const
+        std::vector<std::string> enum_values;
+        std::vector<JsonSchema> any_of;
+        std::string pattern;
+    };
+
+    // Compact JSON text matching schema, with an optional space after ':' and ','. All object
+    // properties are emitted, in declaration order.
+    Pattern pattern_from_json_schema(const JsonSchema &schema);
+
+    // Byte-level deterministic automaton of a pattern, state 0 is the initial state.
+    class Dfa
+    {
+    public:
+        static constexpr uint32_t dead = uint32_t(-1);
+
+        explicit Dfa(const Pattern &pattern);
+
+        uint32_t next(uint32_t state, unsigned char byte) const { return m_transitions[state * 256 + byte]; }
+        bool accepting(uint32_t state) const { return m_accepting[state]; }
+        size_t size() const { return m_accepting.size(); }
+
+    private:
+        std::vector<uint32_t> m_transitions;
+        std::vector<bool> m_accepting;
+    };
+
+    // Token strings of a model, sorted so that walks over the vocabulary can share common prefixes.
+    struct Vocabulary
+    {
+        explicit Vocabulary(std::vector<std::string> tokens);
+
+        std::vector<std::string> tokens;
+        // Token ids in byte-wise lexicographic order, and the common prefix length of each with the previous one
+        std::vector<int32_t> order;
+        std::vector<uint32_t> common_prefix;
+    };
+
+    // Token-level form of a Dfa: for every state, the bitset of tokens whose text keeps the output
+    // inside the language and the state each of them leads to. EOS is allowed in accepting states.
+    class TokenAutomaton
+    {
+    public:
+        // Throws std::length_error when the masks, one vocabulary bitset per DFA state, would take more
+        // than max_mask_bytes.
+        TokenAutomaton(const Dfa &dfa, const Vocabulary &vocabulary, int64_t eos_token_id, size_t max_mask_bytes);
+
+        // Bitset of vocab_size() bits, bit t of word t / 64 is set when token t is allowed.
+        const uint64_t *allowed(uint32_t state) const { return m_masks.data() + state * m_words; }
+        uint32_t next(uint32_t state, int64_t token) const;
+        bool accepting(uint32_t state) const { return m_accepting[state]; }
+        size_t vocab_size() const { return m_vocab_size; }
+        size_t mask_bytes() const { return m_masks.size() * sizeof(uint64_t); }
+
+    private:
+        size_t m_vocab_size;
+        size_t m_words;
+        int64_t m_eos_token_id;
+        std::vector<uint64_t> m_masks;
+        // Per state, allowed tokens and their target states sorted by token id
+        std::vector<std::vector<std::pair<int32_t, uint32_t>>> m_transitions;
+        std::vector<bool> m_accepting;
+    };
+}
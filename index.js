@@ -11,14 +11,11 @@ if (process.argv[3] === "nostream") {
     streaming = false;
 }
 
-let token_count = 0;
-
 if (process.argv.length === 2) {
     console.error('Error: OpenVINO model path is required.');
     process.exit(1);
 }
 function onStream(word) {
-    token_count += 1;
     process.stdout.write(word);
 }
 
@@ -36,15 +33,13 @@ function chatInterface() {
         console.log("AI:")
 
         if (streaming) {
-            const startTime = new Date();
-            ovllm.generateStream(message, onStream)
-            const elapsedTime = (new Date() - startTime) / 1000;
+            const { stats } = ovllm.generateStream(message, onStream);
             console.log("\n");
-            console.log(Math.floor(token_count / elapsedTime), "Tokens/sec\n");
+            console.log(Math.floor(stats.tokensPerSecond), "Tokens/sec,", Math.round(stats.prefillMs), "ms to first token\n");
         }
         else {
-            let response = ovllm.generate(message);
-            console.log(response);
+            const { text } = ovllm.generate(message);
+            console.log(text);
         }
         chatInterface();
     });
@@ -0,0 +1,96 @@
+#include "logits_processor.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include "cpu_features.hpp"
+
+namespace ovllm
+{
+    static constexpr float kMasked = -std::numeric_limits<float>::infinity();
+
+#if defined(OVLLM_X86)
+    OVLLM_TARGET("avx2") static void apply_word_avx2(float *block, uint64_t bits)
+    {
+        const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        const __m256 masked = _mm256_set1_ps(kMasked);
+        for (size_t i = 0; i < 64; i += 8)
+        {
+            const __m256i byte = _mm256_set1_epi32(static_cast<int>((bits >> i) & 0xFF));
+            const __m256i keep = _mm256_cmpeq_epi32(_mm256_and_si256(byte, lanes), lanes);
+            const __m256 values = _mm256_loadu_ps(block + i);
+            _mm256_storeu_ps(block + i, _mm256_blendv_ps(masked, values, _mm256_castsi256_ps(keep)));
+        }
+    }
+
+    OVLLM_TARGET("avx2") static void add_logit_bias_avx2(float *logits, const float *bias, size_t size, size_t &i)
+    {
+        for (; i + 32 <= size; i += 32)
+        {
+            for (size_t j = i; j < i + 32; j += 8)
+            {
+                _mm256_storeu_ps(logits + j, _mm256_add_ps(_mm256_loadu_ps(logits + j), _mm256_loadu_ps(bias + j)));
+            }
+        }
+    }
+#endif
+
+    void apply_token_mask(float *logits, const uint64_t *allowed, size_t size)
+    {
+        const size_t words = size / 64;
+#if defined(OVLLM_X86)
+        const bool avx2 = cpu_features().avx2;
+#endif
+        for (size_t w = 0; w < words; ++w)
+        {
+            const uint64_t bits = allowed[w];
+            float *block = logits + w * 64;
+            // Grammar masks are mostly all-clear words, with a few mixed ones around allowed tokens
+            if (bits == ~uint64_t(0))
+            {
+                continue;
+            }
+            if (bits == 0)
+            {
+                std::fill_n(block, 64, kMasked);
+                continue;
+            }
+#if defined(OVLLM_X86)
+            if (avx2)
+            {
+                apply_word_avx2(block, bits);
+                continue;
+            }
+#endif
+            for (size_t i = 0; i < 64; ++i)
+            {
+                if (!((bits >> i) & 1))
+                {
+                    block[i] = kMasked;
+                }
+            }
+        }
+        for (size_t i = words * 64; i < size; ++i)
+        {
+            if (!((allowed[i / 64] >> (i % 64)) & 1))
+            {
+                logits[i] = kMasked;
+            }
+        }
+    }
+
+    void add_logit_bias(float *logits, const float *bias, size_t size)
+    {
+        size_t i = 0;
+#if defined(OVLLM_X86)
+        if (cpu_features().avx2)
+        {
+            add_logit_bias_avx2(logits, bias, size, i);
+        }
+#endif
+        for (; i < size; ++i)
+        {
+            logits[i] += bias[i];
+        }
+    }
+}
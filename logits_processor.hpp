@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ovllm
+{
+    // Sets logits of tokens whose bit is clear in allowed to -inf. allowed holds size bits, 64 per word.
+    void apply_token_mask(float *logits, const uint64_t *allowed, size_t size);
+
+    // Adds a dense per-token bias to logits, -inf entries ban their tokens.
+    void add_logit_bias(float *logits, const float *bias, size_t size);
+}
@@ -0,0 +1,254 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace ovllm
+{
+    static double milliseconds(Clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    static const char *const kFinishReasons[] = {"eos", "length", "stop", "error"};
+
+    Histogram::Histogram(std::vector<double> bounds)
+        : m_bounds(std::move(bounds)), m_buckets(new std::atomic<uint64_t>[m_bounds.size() + 1])
+    {
+        for (size_t i = 0; i <= m_bounds.size(); ++i)
+        {
+            m_buckets[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void Histogram::observe(double seconds)
+    {
+        const size_t bucket = std::lower_bound(m_bounds.begin(), m_bounds.end(), seconds) - m_bounds.begin();
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum_micros.fetch_add(uint64_t(std::max(0.0, seconds) * 1e6), std::memory_order_relaxed);
+    }
+
+    static void append_sample(std::string &out, const std::string &name, double value)
+    {
+        char number[32];
+        std::snprintf(number, sizeof(number), "%.17g", value);
+        out += name + " " + number + "\n";
+    }
+
+    static void append_header(std::string &out, const std::string &name, const char *type, const std::string &help)
+    {
+        out += "# HELP " + name + " " + help + "\n";
+        out += "# TYPE " + name + " " + type + "\n";
+    }
+
+    void Histogram::write(std::string &out, const std::string &name, const std::string &help) const
+    {
+        append_header(out, name, "histogram", help);
+        write_samples(out, name, "");
+    }
+
+    void Histogram::write_samples(std::string &out, const std::string &name, const std::string &labels) const
+    {
+        const std::string prefix = labels.empty() ? "" : labels + ",";
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i <= m_bounds.size(); ++i)
+        {
+            cumulative += m_buckets[i].load(std::memory_order_relaxed);
+            char bound[32];
+            if (i < m_bounds.size())
+            {
+                std::snprintf(bound, sizeof(bound), "%g", m_bounds[i]);
+            }
+            else
+            {
+                std::snprintf(bound, sizeof(bound), "+Inf");
+            }
+            append_sample(out, name + "_bucket{" + prefix + "le=\"" + bound + "\"}", double(cumulative));
+        }
+        const std::string series = labels.empty() ? "" : "{" + labels + "}";
+        append_sample(out, name + "_sum" + series, m_sum_micros.load(std::memory_order_relaxed) / 1e6);
+        append_sample(out, name + "_count" + series, double(m_count.load(std::memory_order_relaxed)));
+    }
+
+    Metrics::Metrics()
+        : time_to_first_token({0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0}),
+          inter_token_latency({0.005, 0.01, 0.02, 0.035, 0.05, 0.075, 0.1, 0.25, 0.5, 1.0})
+    {
+    }
+
+    TenantMetrics::TenantMetrics()
+        : queue_wait({0.01, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0})
+    {
+    }
+
+    TenantMetrics &Metrics::tenant(const std::string &id)
+    {
+        std::lock_guard<std::mutex> lock(tenants_mutex);
+        std::unique_ptr<TenantMetrics> &entry = tenants[id];
+        if (!entry)
+        {
+            entry = std::make_unique<TenantMetrics>();
+        }
+        return *entry;
+    }
+
+    // tenant="id" with the label value escaped
+    static std::string tenant_label(const std::string &id)
+    {
+        std::string label = "tenant=\"";
+        for (char c : id)
+        {
+            if (c == '\\' || c == '"')
+            {
+                label += '\\';
+                label += c;
+            }
+            else if (c == '\n')
+            {
+                label += "\\n";
+            }
+            else
+            {
+                label += c;
+            }
+        }
+        return label + "\"";
+    }
+
+    Metrics &metrics()
+    {
+        static Metrics instance;
+        return instance;
+    }
+
+    void Metrics::record(FinishReason reason, const GenerationStats &stats, const GenerationTimings &timings)
+    {
+        requests[size_t(reason)].fetch_add(1, std::memory_order_relaxed);
+        prompt_tokens.fetch_add(stats.prompt_tokens, std::memory_order_relaxed);
+        generated_tokens.fetch_add(stats.generated_tokens, std::memory_order_relaxed);
+        if (stats.generated_tokens > 0)
+        {
+            time_to_first_token.observe((timings.tokenize_ms + timings.prefill_ms) / 1000.0);
+            const double decode_ms = timings.total_ms - timings.tokenize_ms - timings.prefill_ms;
+            decode_micros.fetch_add(uint64_t(std::max(0.0, decode_ms) * 1000.0), std::memory_order_relaxed);
+        }
+    }
+
+    std::string Metrics::prometheus() const
+    {
+        std::string out;
+        append_header(out, "ovllm_requests_total", "counter", "Finished generate calls by finish reason.");
+        for (size_t i = 0; i < 4; ++i)
+        {
+            append_sample(out, std::string("ovllm_requests_total{reason=\"") + kFinishReasons[i] + "\"}",
+                          double(requests[i].load(std::memory_order_relaxed)));
+        }
+        append_header(out, "ovllm_prompt_tokens_total", "counter", "Prompt tokens of finished calls.");
+        append_sample(out, "ovllm_prompt_tokens_total", double(prompt_tokens.load(std::memory_order_relaxed)));
+        append_header(out, "ovllm_generated_tokens_total", "counter", "Generated tokens of finished calls.");
+        append_sample(out, "ovllm_generated_tokens_total", double(generated_tokens.load(std::memory_order_relaxed)));
+        append_header(out, "ovllm_decode_seconds_total", "counter",
+                      "Wall time after the first token, generated tokens per decode second is the decode rate.");
+        append_sample(out, "ovllm_decode_seconds_total", decode_micros.load(std::memory_order_relaxed) / 1e6);
+        time_to_first_token.write(out, "ovllm_time_to_first_token_seconds", "Call start to first generated token.");
+        inter_token_latency.write(out, "ovllm_inter_token_latency_seconds", "Gaps between generated tokens.");
+        append_header(out, "ovllm_queue_depth", "gauge", "Requests waiting for a scheduler session.");
+        append_sample(out, "ovllm_queue_depth", double(queued_requests.load(std::memory_order_relaxed)));
+        append_header(out, "ovllm_active_sessions", "gauge", "Generations currently running.");
+        append_sample(out, "ovllm_active_sessions", double(active_sessions.load(std::memory_order_relaxed)));
+        append_header(out, "ovllm_kv_cache_bytes", "gauge", "KV cache held by live sequences.");
+        append_sample(out, "ovllm_kv_cache_bytes", double(kv_cache_bytes.load(std::memory_order_relaxed)));
+        append_header(out, "ovllm_kv_cache_reserved_bytes", "gauge", "Projected peak KV cache of admitted generations.");
+        append_sample(out, "ovllm_kv_cache_reserved_bytes", double(kv_cache_reserved_bytes.load(std::memory_order_relaxed)));
+        append_header(out, "ovllm_rejected_requests_total", "counter", "Requests rejected at submit by the KV cache budget or a full queue.");
+        append_sample(out, "ovllm_rejected_requests_total", double(rejected_requests.load(std::memory_order_relaxed)));
+        append_header(out, "ovllm_preemptions_total", "counter", "Generations suspended at a step boundary for a higher priority request.");
+        append_sample(out, "ovllm_preemptions_total", double(preemptions.load(std::memory_order_relaxed)));
+        append_header(out, "ovllm_preempted_kv_bytes", "gauge", "KV cache snapshots held by suspended generations.");
+        append_sample(out, "ovllm_preempted_kv_bytes", double(preempted_kv_bytes.load(std::memory_order_relaxed)));
+        append_header(out, "ovllm_response_cache_requests_total", "counter", "Response cache lookups of deterministic requests by result.");
+        append_sample(out, "ovllm_response_cache_requests_total{result=\"hit\"}", double(response_cache_hits.load(std::memory_order_relaxed)));
+        append_sample(out, "ovllm_response_cache_requests_total{result=\"miss\"}", double(response_cache_misses.load(std::memory_order_relaxed)));
+        append_header(out, "ovllm_response_cache_bytes", "gauge", "Memory held by cached responses.");
+        append_sample(out, "ovllm_response_cache_bytes", double(response_cache_bytes.load(std::memory_order_relaxed)));
+        append_header(out, "ovllm_coalesced_requests_total", "counter", "Requests served by an identical generation in flight.");
+        append_sample(out, "ovllm_coalesced_requests_total", double(coalesced_requests.load(std::memory_order_relaxed)));
+        append_header(out, "ovllm_model_load_seconds", "gauge", "Read, transform and compile time of the loaded model.");
+        append_sample(out, "ovllm_model_load_seconds", model_load_seconds.load(std::memory_order_relaxed));
+        append_header(out, "ovllm_arena_reserved_bytes", "gauge", "Memory mapped by the tensor arena.");
+        append_sample(out, "ovllm_arena_reserved_bytes", double(arena_reserved_bytes.load(std::memory_order_relaxed)));
+        append_header(out, "ovllm_arena_huge_page_bytes", "gauge", "Arena memory advised for or backed by huge pages.");
+        append_sample(out, "ovllm_arena_huge_page_bytes", double(arena_huge_page_bytes.load(std::memory_order_relaxed)));
+        append_header(out, "ovllm_arena_in_use_bytes", "gauge", "Arena memory held by live tensors, rounded to size classes.");
+        append_sample(out, "ovllm_arena_in_use_bytes", double(arena_in_use_bytes.load(std::memory_order_relaxed)));
+        append_header(out, "ovllm_arena_allocations_total", "counter", "Tensor allocations by whether a freed slot was reused.");
+        append_sample(out, "ovllm_arena_allocations_total{source=\"fresh\"}", double(arena_fresh.load(std::memory_order_relaxed)));
+        append_sample(out, "ovllm_arena_allocations_total{source=\"reused\"}", double(arena_reused.load(std::memory_order_relaxed)));
+
+        std::lock_guard<std::mutex> lock(tenants_mutex);
+        if (tenants.empty())
+        {
+            return out;
+        }
+        append_header(out, "ovllm_tenant_requests_total", "counter", "Requests admitted by the scheduler per tenant.");
+        for (const auto &[id, tenant] : tenants)
+        {
+            append_sample(out, "ovllm_tenant_requests_total{" + tenant_label(id) + "}", double(tenant->requests.load(std::memory_order_relaxed)));
+        }
+        append_header(out, "ovllm_tenant_tokens_total", "counter", "Prompt and generated tokens per tenant, the usage its rate limit counts.");
+        for (const auto &[id, tenant] : tenants)
+        {
+            append_sample(out, "ovllm_tenant_tokens_total{" + tenant_label(id) + ",kind=\"prompt\"}",
+                          double(tenant->prompt_tokens.load(std::memory_order_relaxed)));
+            append_sample(out, "ovllm_tenant_tokens_total{" + tenant_label(id) + ",kind=\"generated\"}",
+                          double(tenant->generated_tokens.load(std::memory_order_relaxed)));
+        }
+        append_header(out, "ovllm_tenant_queue_wait_seconds", "histogram", "Submit to admission per tenant.");
+        for (const auto &[id, tenant] : tenants)
+        {
+            tenant->queue_wait.write_samples(out, "ovllm_tenant_queue_wait_seconds", tenant_label(id));
+        }
+        return out;
+    }
+
+    void GenerationTimer::token()
+    {
+        const Clock::time_point now = Clock::now();
+        if (!m_tokens.empty())
+        {
+            metrics().inter_token_latency.observe(std::chrono::duration<double>(now - m_tokens.back()).count());
+        }
+        m_tokens.push_back(now);
+    }
+
+    GenerationTimings GenerationTimer::finish() const
+    {
+        GenerationTimings timings;
+        timings.tokenize_ms = milliseconds(m_tokenized - m_start);
+        timings.detokenize_ms = milliseconds(m_detokenize);
+        timings.total_ms = milliseconds(Clock::now() - m_start);
+        if (m_tokens.empty())
+        {
+            return timings;
+        }
+        timings.prefill_ms = milliseconds(m_tokens.front() - m_tokenized);
+
+        // Tokens accepted together from one prompt lookup pass count as zero-length gaps
+        std::vector<double> gaps;
+        gaps.reserve(m_tokens.size() - 1);
+        for (size_t i = 1; i < m_tokens.size(); ++i)
+        {
+            gaps.push_back(milliseconds(m_tokens[i] - m_tokens[i - 1]));
+        }
+        if (!gaps.empty())
+        {
+            timings.mean_inter_token_ms = milliseconds(m_tokens.back() - m_tokens.front()) / gaps.size();
+            const size_t rank = size_t(std::ceil(0.99 * gaps.size())) - 1;
+            std::nth_element(gaps.begin(), gaps.begin() + rank, gaps.end());
+            timings.p99_inter_token_ms = gaps[rank];
+        }
+        return timings;
+    }
+}
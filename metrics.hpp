@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "openvino/genai/streamer_base.hpp"
+#include "engine.hpp"
+
+namespace ovllm
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Wall-clock timings of one generate call, in milliseconds.
+    struct GenerationTimings
+    {
+        double tokenize_ms = 0.0;
+        // From the end of tokenization to the first generated token (TTFT without tokenization)
+        double prefill_ms = 0.0;
+        double mean_inter_token_ms = 0.0;
+        double p99_inter_token_ms = 0.0;
+        double detokenize_ms = 0.0;
+        double total_ms = 0.0;
+    };
+
+    // Prometheus histogram over fixed upper bounds, in seconds. observe() is a few relaxed atomic
+    // increments, safe from any thread.
+    class Histogram
+    {
+    public:
+        explicit Histogram(std::vector<double> bounds);
+
+        void observe(double seconds);
+        void write(std::string &out, const std::string &name, const std::string &help) const;
+        // Samples of one labelled series, labels like tenant="a", after a header written by the caller.
+        void write_samples(std::string &out, const std::string &name, const std::string &labels) const;
+
+    private:
+        std::vector<double> m_bounds;
+        // One count per bound plus +Inf, not cumulative
+        std::unique_ptr<std::atomic<uint64_t>[]> m_buckets;
+        std::atomic<uint64_t> m_count{0};
+        std::atomic<uint64_t> m_sum_micros{0};
+    };
+
+    // Usage and queueing of one scheduler tenant.
+    struct TenantMetrics
+    {
+        TenantMetrics();
+
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> prompt_tokens{0};
+        std::atomic<uint64_t> generated_tokens{0};
+        // Submit to admission
+        Histogram queue_wait;
+    };
+
+    // Process-wide counters and gauges of the addon, updated with relaxed atomics so that the decode
+    // loop and scheduler thread never wait on instrumentation.
+    struct Metrics
+    {
+        Metrics();
+
+        // Counts a finished generate call.
+        void record(FinishReason reason, const GenerationStats &stats, const GenerationTimings &timings);
+        // Snapshot in the Prometheus text exposition format.
+        std::string prometheus() const;
+        // Metrics of a tenant, created on first use and valid for the life of the process.
+        TenantMetrics &tenant(const std::string &id);
+
+        std::atomic<uint64_t> requests[4] = {};
+        std::atomic<uint64_t> prompt_tokens{0};
+        std::atomic<uint64_t> generated_tokens{0};
+        // Wall time after the first token of each request, generated_tokens over it is the decode rate
+        std::atomic<uint64_t> decode_micros{0};
+        Histogram time_to_first_token;
+        Histogram inter_token_latency;
+        std::atomic<int64_t> queued_requests{0};
+        std::atomic<int64_t> active_sessions{0};
+        std::atomic<int64_t> kv_cache_bytes{0};
+        // Projected peak KV cache of admitted generations, and requests turned away at submit
+        std::atomic<int64_t> kv_cache_reserved_bytes{0};
+        std::atomic<uint64_t> rejected_requests{0};
+        // Generations suspended for higher priority requests, and the KV cache snapshots they hold
+        std::atomic<uint64_t> preemptions{0};
+        std::atomic<int64_t> preempted_kv_bytes{0};
+        std::atomic<uint64_t> response_cache_hits{0};
+        std::atomic<uint64_t> response_cache_misses{0};
+        std::atomic<int64_t> response_cache_bytes{0};
+        // generateAsync calls attached to an identical generation in flight
+        std::atomic<uint64_t> coalesced_requests{0};
+        std::atomic<double> model_load_seconds{0.0};
+        // Tensor arena: mapped, huge page backed and allocated bytes, allocations served fresh and from free lists
+        std::atomic<int64_t> arena_reserved_bytes{0};
+        std::atomic<int64_t> arena_huge_page_bytes{0};
+        std::atomic<int64_t> arena_in_use_bytes{0};
+        std::atomic<uint64_t> arena_fresh{0};
+        std::atomic<uint64_t> arena_reused{0};
+        mutable std::mutex tenants_mutex;
+        std::map<std::string, std::unique_ptr<TenantMetrics>> tenants;
+    };
+
+    Metrics &metrics();
+
+    // Collects timestamps of one generate call. token() may be called from a worker thread as long
+    // as finish() happens after the last of those calls.
+    class GenerationTimer
+    {
+    public:
+        GenerationTimer() : m_start(Clock::now()), m_tokenized(m_start) {}
+
+        void tokenized() { m_tokenized = Clock::now(); }
+        // Also feeds the inter-token latency histogram.
+        void token();
+        void detokenized(Clock::duration duration) { m_detokenize += duration; }
+        size_t tokens() const { return m_tokens.size(); }
+        GenerationTimings finish() const;
+
+    private:
+        Clock::time_point m_start;
+        Clock::time_point m_tokenized;
+        std::vector<Clock::time_point> m_tokens;
+        Clock::duration m_detokenize{};
+    };
+
+    // Stamps every token on a timer before passing it on.
+    class TimedStreamer : public ov::genai::StreamerBase
+    {
+    public:
+        TimedStreamer(std::shared_ptr<ov::genai::StreamerBase> streamer, GenerationTimer &timer)
+            : m_streamer(std::move(streamer)), m_timer(timer) {}
+
+        bool put(int64_t token) override
+        {
+            m_timer.token();
+            m_stopped = m_streamer->put(token);
+            return m_stopped;
+        }
+        void end() override { m_streamer->end(); }
+        // Whether the wrapped streamer asked to stop.
+        bool stopped() const { return m_stopped; }
+
+    private:
+        std::shared_ptr<ov::genai::StreamerBase> m_streamer;
+        GenerationTimer &m_timer;
+        bool m_stopped = false;
+    };
+}
@@ -0,0 +1,133 @@
+#include "mock_backend.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#include "metrics.hpp"
+#include "tracer.hpp"
+
+namespace ovllm
+{
+    // Sleeps through most of the duration and spins the rest, timer resolution on some platforms is
+    // too coarse for sub-millisecond steps.
+    static void wait_for(std::chrono::steady_clock::duration duration)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + duration;
+        if (duration > std::chrono::milliseconds(2))
+        {
+            std::this_thread::sleep_until(deadline - std::chrono::milliseconds(2));
+        }
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    MockGeneration::MockGeneration(const MockEngine &engine, MockSession &session, Request request)
+        : m_engine(engine), m_session(&session), m_request(std::move(request))
+    {
+        if (m_request.prompt.empty())
+        {
+            throw std::invalid_argument("Prompt is empty");
+        }
+        m_max_new_tokens = m_request.config.get_max_new_tokens(m_request.prompt.size());
+        m_result.stats.prompt_tokens = m_request.prompt.size();
+        m_session->reset();
+        metrics().active_sessions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    MockGeneration::~MockGeneration()
+    {
+        if (!suspended())
+        {
+            metrics().active_sessions.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    size_t MockGeneration::suspend()
+    {
+        m_snapshot = m_session->snapshot();
+        m_session->reset();
+        m_session = nullptr;
+        metrics().active_sessions.fetch_sub(1, std::memory_order_relaxed);
+        // What the KV cache copies of the sequence would take
+        const MockOptions &options = m_engine.options();
+        return m_snapshot * (options.snapshot_bytes_per_token != 0 ? options.snapshot_bytes_per_token : options.kv_bytes_per_token);
+    }
+
+    void MockGeneration::resume(MockSession &session)
+    {
+        session.restore(m_snapshot);
+        m_session = &session;
+        metrics().active_sessions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool MockGeneration::step()
+    {
+        if (m_finished)
+        {
+            return false;
+        }
+        const MockOptions &options = m_engine.options();
+        const size_t vocab = std::max<size_t>(options.vocab_size, 2);
+        const int64_t eos = m_request.config.eos_token_id;
+        // Next token: a walk over the vocabulary from the prompt, stepping over EOS
+        int64_t token = int64_t((m_request.prompt.back() + m_request.prompt.size() + m_result.tokens.size()) % vocab);
+        if (token == eos)
+        {
+            token = (token + 1) % vocab;
+        }
+        if (prefilling())
+        {
+            const size_t chunk = options.prefill_chunk == 0 ? m_request.prompt.size() : options.prefill_chunk;
+            const size_t count = std::min(chunk, m_request.prompt.size() - m_prefilled);
+            trace::Span span("prefill_chunk", m_request.id);
+            wait_for(options.prefill_latency * count / chunk);
+            m_session->advance(count);
+            m_prefilled += count;
+            ++m_result.stats.forward_passes;
+            if (!prefilling())
+            {
+                if (m_max_new_tokens == 0)
+                {
+                    m_result.finish_reason = FinishReason::length;
+                    m_finished = true;
+                }
+                else
+                {
+                    m_finished = emit(token);
+                }
+            }
+        }
+        else
+        {
+            trace::Span span("decode_step", m_request.id);
+            if (options.tokens_per_second > 0.0)
+            {
+                wait_for(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / options.tokens_per_second)));
+            }
+            m_session->advance(1);
+            ++m_result.stats.forward_passes;
+            m_finished = emit(token);
+        }
+        m_result.stats.generated_tokens = m_result.tokens.size();
+        return !m_finished;
+    }
+
+    bool MockGeneration::emit(int64_t token)
+    {
+        m_result.tokens.push_back(token);
+        if (m_request.on_token && m_request.on_token(token))
+        {
+            m_result.finish_reason = FinishReason::stop;
+            return true;
+        }
+        if (m_result.tokens.size() >= m_max_new_tokens)
+        {
+            m_result.finish_reason = FinishReason::length;
+            return true;
+        }
+        return false;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+
+#include "engine.hpp"
+
+namespace ovllm
+{
+    // Synthetic cost of the mock's forward passes.
+    struct MockOptions
+    {
+        // Duration of a prefill pass over a full chunk, shorter chunks take proportionally less
+        std::chrono::microseconds prefill_latency{20000};
+        // Decode steps per second of one session, 0 runs steps without delay
+        double tokens_per_second = 50.0;
+        size_t prefill_chunk = 512;
+        size_t vocab_size = 32000;
+        // TinyLlama: 22 layers of 4 KV heads of size 64, keys and values at f16
+        size_t kv_bytes_per_token = 22 * 2 * 4 * 64 * 2;
+        // Size of a suspended sequence's snapshot per position, 0 is kv_bytes_per_token. Copies of a KV
+        // cache keep the precision its variables declare, which can be wider than the compiled one.
+        size_t snapshot_bytes_per_token = 0;
+    };
+
+    class MockSession
+    {
+    public:
+        void reset() { m_length = 0; }
+        size_t length() const { return m_length; }
+        void advance(size_t count) { m_length += count; }
+        // The mock's snapshot of a sequence is its length.
+        size_t snapshot() const { return m_length; }
+        void restore(size_t length) { m_length = length; }
+
+    private:
+        size_t m_length = 0;
+    };
+
+    class MockEngine;
+
+    // Generation with the interface and step structure of Generation: prefill chunks, then one token
+    // per decode step. Tokens are a deterministic function of the prompt and position, never EOS.
+    class MockGeneration
+    {
+    public:
+        MockGeneration(const MockEngine &engine, MockSession &session, Request request);
+        MockGeneration(const MockGeneration &) = delete;
+        MockGeneration &operator=(const MockGeneration &) = delete;
+        ~MockGeneration();
+
+        bool step();
+        size_t suspend();
+        void resume(MockSession &session);
+        bool suspended() const { return m_session == nullptr; }
+        bool finished() const { return m_finished; }
+        bool prefilling() const { return m_prefilled < m_request.prompt.size(); }
+        Result &result() { return m_result; }
+
+    private:
+        bool emit(int64_t token);
+
+        const MockEngine &m_engine;
+        MockSession *m_session;
+        size_t m_snapshot = 0;
+        Request m_request;
+        size_t m_max_new_tokens = 0;
+        Result m_result;
+        size_t m_prefilled = 0;
+        bool m_finished = false;
+    };
+
+    // Model-free backend for benchmarks of the scheduling and streaming layers in CI: forward passes
+    // only wait out their synthetic latency.
+    class MockEngine
+    {
+    public:
+        explicit MockEngine(const MockOptions &options = {}) : m_options(options) {}
+
+        // The mock keeps no KV cache, a session only counts positions.
+        std::unique_ptr<MockSession> create_session() { return std::make_unique<MockSession>(); }
+        const MockOptions &options() const { return m_options; }
+        size_t vocab_size() const { return m_options.vocab_size; }
+        size_t prefill_chunk() const { return m_options.prefill_chunk; }
+        size_t kv_bytes_per_token() const { return m_options.kv_bytes_per_token; }
+
+    private:
+        MockOptions m_options;
+    };
+}
@@ -0,0 +1,93 @@
+#include "model_transforms.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "openvino/op/constant.hpp"
+#include "openvino/op/convert.hpp"
+#include "openvino/op/matmul.hpp"
+#include "openvino/op/result.hpp"
+#include "openvino/op/slice.hpp"
+#include "openvino/op/topk.hpp"
+#include "openvino/pass/manager.hpp"
+#include "openvino/pass/pattern/op/optional.hpp"
+#include "openvino/pass/pattern/op/wrap_type.hpp"
+
+namespace ovllm
+{
+    static std::shared_ptr<ov::op::v0::Result> find_result(const std::shared_ptr<ov::Model> &model, const std::string &name)
+    {
+        for (const auto &result : model->get_results())
+        {
+            if (result->output(0).get_names().count(name) > 0)
+            {
+                return result;
+            }
+        }
+        throw std::runtime_error("Model has no " + name + " output");
+    }
+
+    SliceLogitsPositions::SliceLogitsPositions(size_t positions)
+    {
+        using namespace ov::pass::pattern;
+        auto hidden = any_input(rank_equals(3));
+        auto lm_head = wrap_type<ov::op::v0::MatMul>({hidden, any_input()});
+        auto converted = optional<ov::op::v0::Convert>(lm_head);
+        auto logits = wrap_type<ov::op::v0::Result>({converted}, [](const ov::Output<ov::Node> &output)
+        {
+            return output.get_names().count("logits") > 0;
+        });
+
+        ov::matcher_pass_callback callback = [=](Matcher &matcher)
+        {
+            const auto &values = matcher.get_pattern_value_map();
+            std::shared_ptr<ov::Node> matmul = values.at(lm_head).get_node_shared_ptr();
+            const ov::Output<ov::Node> states = values.at(hidden);
+
+            // Negative start counts from the end, and is clamped to 0 for sequences shorter than positions
+            auto start = ov::op::v0::Constant::create(ov::element::i64, ov::Shape{1}, {-int64_t(positions)});
+            auto stop = ov::op::v0::Constant::create(ov::element::i64, ov::Shape{1}, {std::numeric_limits<int64_t>::max()});
+            auto step = ov::op::v0::Constant::create(ov::element::i64, ov::Shape{1}, {int64_t(1)});
+            auto axis = ov::op::v0::Constant::create(ov::element::i64, ov::Shape{1}, {int64_t(1)});
+            auto last = std::make_shared<ov::op::v8::Slice>(states, start, stop, step, axis);
+            last->set_friendly_name(matmul->get_friendly_name() + "/slice_positions");
+
+            matmul->input(0).replace_source_output(last);
+            matmul->revalidate_and_infer_types();
+            return true;
+        };
+        register_matcher(std::make_shared<Matcher>(logits, "SliceLogitsPositions"), callback);
+    }
+
+    bool slice_logits_positions(const std::shared_ptr<ov::Model> &model, size_t positions)
+    {
+        ov::pass::Manager manager;
+        manager.register_pass<SliceLogitsPositions>(positions);
+        const bool changed = manager.run_passes(model);
+        model->validate_nodes_and_infer_types();
+        return changed;
+    }
+
+    void append_top_k(const std::shared_ptr<ov::Model> &model, size_t k)
+    {
+        std::shared_ptr<ov::op::v0::Result> logits = find_result(model, "logits");
+        const ov::Output<ov::Node> producer = logits->input_value(0);
+        const ov::Dimension vocab = *producer.get_partial_shape().rbegin();
+        if (vocab.is_static())
+        {
+            k = std::min<size_t>(k, vocab.get_length());
+        }
+
+        auto count = ov::op::v0::Constant::create(ov::element::i64, ov::Shape{}, {int64_t(k)});
+        auto top_k = std::make_shared<ov::op::v11::TopK>(producer, count, -1, ov::op::TopKMode::MAX,
+                                                         ov::op::TopKSortType::SORT_VALUES, ov::element::i32);
+        top_k->output(0).set_names({"top_k_values"});
+        top_k->output(1).set_names({"top_k_indices"});
+
+        model->remove_result(logits);
+        model->add_results({std::make_shared<ov::op::v0::Result>(top_k->output(0)),
+                            std::make_shared<ov::op::v0::Result>(top_k->output(1))});
+        model->validate_nodes_and_infer_types();
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <memory>
+
+#include "openvino/core/model.hpp"
+#include "openvino/pass/graph_rewrite.hpp"
+
+namespace ovllm
+{
+    // Slices the hidden states entering the LM head MatMul to the last positions of the sequence, so
+    // a prefill computes positions * vocab logits instead of one row per prompt token. Matches the
+    // MatMul feeding the logits output directly or through a Convert.
+    class SliceLogitsPositions : public ov::pass::MatcherPass
+    {
+    public:
+        OPENVINO_RTTI("SliceLogitsPositions", "ovllm");
+        explicit SliceLogitsPositions(size_t positions);
+    };
+
+    // Runs SliceLogitsPositions, returns false when the model's LM head was not recognized.
+    bool slice_logits_positions(const std::shared_ptr<ov::Model> &model, size_t positions);
+
+    // Replaces the logits output with top_k_values [batch, seq, k], sorted descending, and
+    // top_k_indices (i32 token ids), so a decode step reads back k entries instead of the vocabulary.
+    void append_top_k(const std::shared_ptr<ov::Model> &model, size_t k);
+}
@@ -1,8 +1,681 @@
 #include <napi.h>
+#include <atomic>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
 #include "openvino/genai/llm_pipeline.hpp"
+#include "engine.hpp"
+#include "metrics.hpp"
+#include "response_cache.hpp"
+#include "scheduler.hpp"
+#include "tracer.hpp"
+#include "text_streamer.hpp"
+#include "token_streamer.hpp"
 
+static ovllm::Engine *engine = nullptr;
+static ovllm::Session *session = nullptr;
 static ov::genai::LLMPipeline *pipe = nullptr;
+static ovllm::Scheduler *scheduler = nullptr;
 static bool streaming = false;
+// Request ids for traces, assigned on the JS thread
+static uint64_t lastRequestId = 0;
+// Compiled grammars by their JSON options, compiling walks the whole vocabulary once per state. JS
+// thread only, like compilation.
+static std::map<std::string, std::shared_ptr<const ovllm::TokenAutomaton>> grammars;
+static const size_t maxCachedGrammars = 32;
+// Responses of deterministic requests, when enabled at initialize
+static ovllm::ResponseCache *responseCache = nullptr;
+// The loaded model in response cache keys
+static std::string modelId;
+// Identical concurrent generateAsync calls share one generation
+static bool coalesceRequests = false;
+
+static ov::genai::GenerationConfig GenerationConfigFromOptions(const Napi::Object &options)
+{
+    ov::genai::GenerationConfig config = engine->generation_config();
+    config.max_new_tokens = 256;
+    if (options.Has("maxNewTokens"))
+    {
+        config.max_new_tokens = options.Get("maxNewTokens").As<Napi::Number>().Uint32Value();
+    }
+    if (options.Has("doSample"))
+    {
+        config.do_sample = options.Get("doSample").As<Napi::Boolean>().Value();
+    }
+    if (options.Has("temperature"))
+    {
+        config.temperature = options.Get("temperature").As<Napi::Number>().FloatValue();
+    }
+    if (options.Has("topK"))
+    {
+        config.top_k = options.Get("topK").As<Napi::Number>().Uint32Value();
+    }
+    if (options.Has("topP"))
+    {
+        config.top_p = options.Get("topP").As<Napi::Number>().FloatValue();
+    }
+    if (options.Has("repetitionPenalty"))
+    {
+        config.repetition_penalty = options.Get("repetitionPenalty").As<Napi::Number>().FloatValue();
+    }
+    if (options.Has("ignoreEos"))
+    {
+        config.ignore_eos = options.Get("ignoreEos").As<Napi::Boolean>().Value();
+    }
+    return config;
+}
+
+static std::optional<ovllm::PromptLookupConfig> PromptLookupFromOptions(const Napi::Object &options)
+{
+    if (!options.Has("promptLookup"))
+    {
+        return std::nullopt;
+    }
+    Napi::Value value = options.Get("promptLookup");
+    if (value.IsBoolean())
+    {
+        if (!value.As<Napi::Boolean>().Value())
+        {
+            return std::nullopt;
+        }
+        return ovllm::PromptLookupConfig{};
+    }
+    ovllm::PromptLookupConfig lookup;
+    Napi::Object lookupOptions = value.As<Napi::Object>();
+    if (lookupOptions.Has("ngramSize"))
+    {
+        lookup.max_ngram_size = lookupOptions.Get("ngramSize").As<Napi::Number>().Uint32Value();
+    }
+    if (lookupOptions.Has("numCandidates"))
+    {
+        lookup.num_candidates = lookupOptions.Get("numCandidates").As<Napi::Number>().Uint32Value();
+    }
+    return lookup;
+}
+
+static std::vector<std::string> StopStringsFromOptions(const Napi::Object &options)
+{
+    std::vector<std::string> stop;
+    if (!options.Has("stop"))
+    {
+        return stop;
+    }
+    Napi::Array strings = options.Get("stop").As<Napi::Array>();
+    for (uint32_t i = 0; i < strings.Length(); ++i)
+    {
+        stop.push_back(strings.Get(i).As<Napi::String>().Utf8Value());
+    }
+    return stop;
+}
+
+static std::string JsonStringify(Napi::Env env, const Napi::Value &value)
+{
+    Napi::Object json = env.Global().Get("JSON").As<Napi::Object>();
+    return json.Get("stringify").As<Napi::Function>().Call(json, {value}).As<Napi::String>().Utf8Value();
+}
+
+static ovllm::JsonSchema JsonSchemaFromObject(Napi::Env env, const Napi::Object &object)
+{
+    ovllm::JsonSchema schema;
+    if (object.Has("type"))
+    {
+        schema.type = object.Get("type").As<Napi::String>().Utf8Value();
+    }
+    if (object.Has("properties"))
+    {
+        Napi::Object properties = object.Get("properties").As<Napi::Object>();
+        Napi::Array names = properties.GetPropertyNames();
+        for (uint32_t i = 0; i < names.Length(); ++i)
+        {
+            std::string name = names.Get(i).As<Napi::String>().Utf8Value();
+            schema.properties.emplace_back(name, JsonSchemaFromObject(env, properties.Get(name).As<Napi::Object>()));
+        }
+    }
+    if (object.Has("items"))
+    {
+        schema.items = std::make_shared<ovllm::JsonSchema>(JsonSchemaFromObject(env, object.Get("items").As<Napi::Object>()));
+    }
+    if (object.Has("minItems"))
+    {
+        schema.min_items = object.Get("minItems").As<Napi::Number>().Uint32Value();
+    }
+    if (object.Has("maxItems"))
+    {
+        schema.max_items = object.Get("maxItems").As<Napi::Number>().Uint32Value();
+    }
+    if (object.Has("enum"))
+    {
+        Napi::Array values = object.Get("enum").As<Napi::Array>();
+        for (uint32_t i = 0; i < values.Length(); ++i)
+        {
+            schema.enum_values.push_back(JsonStringify(env, values.Get(i)));
+        }
+    }
+    if (object.Has("const"))
+    {
+        schema.enum_values.push_back(JsonStringify(env, object.Get("const")));
+    }
+    for (const char *key : {"anyOf", "oneOf"})
+    {
+        if (object.Has(key))
+        {
+            Napi::Array options = object.Get(key).As<Napi::Array>();
+            for (uint32_t i = 0; i < options.Length(); ++i)
+            {
+                schema.any_of.push_back(JsonSchemaFromObject(env, options.Get(i).As<Napi::Object>()));
+            }
+        }
+    }
+    if (object.Has("pattern"))
+    {
+        schema.pattern = object.Get("pattern").As<Napi::String>().Utf8Value();
+    }
+    return schema;
+}
+
+// grammar: { jsonSchema: {...} } or { regex: "..." }
+static std::shared_ptr<const ovllm::TokenAutomaton> GrammarFromOptions(Napi::Env env, const Napi::Object &options)
+{
+    if (!options.Has("grammar"))
+    {
+        return nullptr;
+    }
+    Napi::Object grammar = options.Get("grammar").As<Napi::Object>();
+    std::string key = JsonStringify(env, grammar);
+    auto cached = grammars.find(key);
+    if (cached != grammars.end())
+    {
+        return cached->second;
+    }
+
+    ovllm::Pattern pattern;
+    if (grammar.Has("jsonSchema"))
+    {
+        pattern = ovllm::pattern_from_json_schema(JsonSchemaFromObject(env, grammar.Get("jsonSchema").As<Napi::Object>()));
+    }
+    else if (grammar.Has("regex"))
+    {
+        pattern = ovllm::parse_regex(grammar.Get("regex").As<Napi::String>().Utf8Value());
+    }
+    else
+    {
+        throw std::invalid_argument("Expected grammar.jsonSchema or grammar.regex");
+    }
+    if (grammars.size() >= maxCachedGrammars)
+    {
+        grammars.clear();
+    }
+    return grammars[key] = engine->compile_grammar(pattern);
+}
+
+// logitBias: { tokenId: bias }, bannedTokens: [tokenId], expanded to one dense bias per token
+static std::vector<float> LogitBiasFromOptions(const Napi::Object &options)
+{
+    std::vector<float> bias;
+    if (!options.Has("logitBias") && !options.Has("bannedTokens"))
+    {
+        return bias;
+    }
+    bias.resize(engine->vocab_size(), 0.0f);
+    auto checkedId = [&bias](int64_t id)
+    {
+        if (id < 0 || size_t(id) >= bias.size())
+        {
+            throw std::out_of_range("Token id " + std::to_string(id) + " is outside of the vocabulary");
+        }
+        return size_t(id);
+    };
+    if (options.Has("logitBias"))
+    {
+        Napi::Object biases = options.Get("logitBias").As<Napi::Object>();
+        Napi::Array ids = biases.GetPropertyNames();
+        for (uint32_t i = 0; i < ids.Length(); ++i)
+        {
+            std::string id = ids.Get(i).As<Napi::String>().Utf8Value();
+            bias[checkedId(std::stoll(id))] = biases.Get(id).As<Napi::Number>().FloatValue();
+        }
+    }
+    if (options.Has("bannedTokens"))
+    {
+        Napi::Array banned = options.Get("bannedTokens").As<Napi::Array>();
+        for (uint32_t i = 0; i < banned.Length(); ++i)
+        {
+            bias[checkedId(banned.Get(i).As<Napi::Number>().Int64Value())] = -std::numeric_limits<float>::infinity();
+        }
+    }
+    return bias;
+}
+
+static bool UsesNativeDecoding(const Napi::Object &options)
+{
+    return PromptLookupFromOptions(options) || options.Has("grammar") || options.Has("logitBias") || options.Has("bannedTokens") ||
+           options.Has("seed");
+}
+
+static Napi::Object StatsToObject(Napi::Env env, const ovllm::GenerationStats &stats, const ovllm::GenerationTimings &timings)
+{
+    Napi::Object object = Napi::Object::New(env);
+    object.Set("promptTokens", Napi::Number::New(env, stats.prompt_tokens));
+    object.Set("generatedTokens", Napi::Number::New(env, stats.generated_tokens));
+    object.Set("forwardPasses", Napi::Number::New(env, stats.forward_passes));
+    object.Set("draftTokens", Napi::Number::New(env, stats.draft_tokens));
+    object.Set("acceptedTokens", Napi::Number::New(env, stats.accepted_tokens));
+    double acceptanceRate = stats.draft_tokens ? double(stats.accepted_tokens) / stats.draft_tokens : 0.0;
+    object.Set("acceptanceRate", Napi::Number::New(env, acceptanceRate));
+    object.Set("tokenizeMs", Napi::Number::New(env, timings.tokenize_ms));
+    object.Set("prefillMs", Napi::Number::New(env, timings.prefill_ms));
+    object.Set("meanInterTokenMs", Napi::Number::New(env, timings.mean_inter_token_ms));
+    object.Set("p99InterTokenMs", Napi::Number::New(env, timings.p99_inter_token_ms));
+    object.Set("detokenizeMs", Napi::Number::New(env, timings.detokenize_ms));
+    object.Set("totalMs", Napi::Number::New(env, timings.total_ms));
+    double seconds = (timings.total_ms - timings.tokenize_ms - timings.prefill_ms) / 1000.0;
+    object.Set("tokensPerSecond", Napi::Number::New(env, stats.generated_tokens > 1 && seconds > 0.0 ? (stats.generated_tokens - 1) / seconds : 0.0));
+    return object;
+}
+
+static Napi::Object ResultToObject(Napi::Env env, const char *key, const Napi::Value &value, const ovllm::GenerationStats &stats,
+                                   const ovllm::GenerationTimings &timings)
+{
+    Napi::Object response = Napi::Object::New(env);
+    response.Set(key, value);
+    response.Set("stats", StatsToObject(env, stats, timings));
+    return response;
+}
+
+// Generated text as a string, or with textAsBuffer as a Buffer that takes over the native bytes
+// without a copy. External strings are still experimental in N-API, Buffers are the stable way to
+// hand native memory to JS.
+static Napi::Value TextToValue(Napi::Env env, std::string &&text, bool asBuffer)
+{
+    if (!asBuffer)
+    {
+        return Napi::String::New(env, text);
+    }
+    auto *owned = new std::string(std::move(text));
+    return Napi::Buffer<char>::New(env, owned->data(), owned->size(), [](Napi::Env, char *, std::string *data)
+    {
+        delete data;
+    }, owned);
+}
+
+static bool TextAsBufferFromOptions(const Napi::Object &options)
+{
+    return options.Has("textAsBuffer") && options.Get("textAsBuffer").As<Napi::Boolean>().Value();
+}
+
+// Prompts are strings or Buffers of UTF-8 text. A Buffer is copied as is, a string is flattened and
+// transcoded by V8 first, which shows for prompts of many kilobytes.
+static bool IsTextPrompt(const Napi::Value &input)
+{
+    return input.IsString() || input.IsBuffer();
+}
+
+static std::string PromptText(const Napi::Value &input)
+{
+    if (input.IsBuffer())
+    {
+        Napi::Buffer<char> buffer = input.As<Napi::Buffer<char>>();
+        return std::string(buffer.Data(), buffer.Length());
+    }
+    return input.As<Napi::String>().Utf8Value();
+}
+
+// BigInt64Array token ids are wrapped in place as the input tensor, no copy is made. The array is
+// referenced by the call's arguments, so its memory stays pinned until the synchronous generate returns.
+static ov::Tensor TokenTensorFromTypedArray(const Napi::TypedArray &array)
+{
+    if (array.TypedArrayType() == napi_bigint64_array)
+    {
+        Napi::BigInt64Array ids = array.As<Napi::BigInt64Array>();
+        return ov::Tensor(ov::element::i64, {1, ids.ElementLength()}, ids.Data());
+    }
+    if (array.TypedArrayType() == napi_int32_array)
+    {
+        Napi::Int32Array ids = array.As<Napi::Int32Array>();
+        ov::Tensor tensor(ov::element::i64, {1, ids.ElementLength()}, engine->allocator());
+        std::copy_n(ids.Data(), ids.ElementLength(), tensor.data<int64_t>());
+        return tensor;
+    }
+    throw std::invalid_argument("Expected token ids as a BigInt64Array or an Int32Array");
+}
+
+static ov::genai::EncodedInputs EncodedInputsFromTypedArray(const Napi::TypedArray &array, const Napi::Object &options)
+{
+    ov::Tensor inputIds = TokenTensorFromTypedArray(array);
+    if (!options.Has("attentionMask"))
+    {
+        return inputIds;
+    }
+    Napi::Value mask = options.Get("attentionMask");
+    if (!mask.IsTypedArray())
+    {
+        throw std::invalid_argument("Expected attentionMask as a BigInt64Array or an Int32Array");
+    }
+    ov::Tensor attentionMask = TokenTensorFromTypedArray(mask.As<Napi::TypedArray>());
+    if (attentionMask.get_shape() != inputIds.get_shape())
+    {
+        throw std::invalid_argument("Attention mask must have as many elements as the token ids");
+    }
+    return ov::genai::TokenizedInputs{inputIds, attentionMask};
+}
+
+// Checks the attentionMask option of a token id prompt before it reaches a tensor: a BigInt64Array or
+// Int32Array with one element per token id. Throws a TypeError and returns false otherwise.
+static bool CheckAttentionMask(Napi::Env env, const Napi::Value &input, const Napi::Object &options)
+{
+    if (IsTextPrompt(input) || !options.Has("attentionMask"))
+    {
+        return true;
+    }
+    Napi::Value value = options.Get("attentionMask");
+    const char *error = nullptr;
+    if (!value.IsTypedArray())
+    {
+        error = "Expected attentionMask as a BigInt64Array or an Int32Array";
+    }
+    else
+    {
+        Napi::TypedArray mask = value.As<Napi::TypedArray>();
+        if (mask.TypedArrayType() != napi_bigint64_array && mask.TypedArrayType() != napi_int32_array)
+        {
+            error = "Expected attentionMask as a BigInt64Array or an Int32Array";
+        }
+        else if (mask.ElementLength() != input.As<Napi::TypedArray>().ElementLength())
+        {
+            error = "Attention mask must have as many elements as the token ids";
+        }
+    }
+    if (error != nullptr)
+    {
+        Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+        return false;
+    }
+    return true;
+}
+
+// Token ids of a prompt string or typed array for the addon's decode loop, which runs one unpadded sequence
+static std::vector<int64_t> PromptFromInput(const Napi::Value &input, const Napi::Object &options)
+{
+    if (IsTextPrompt(input))
+    {
+        return engine->encode(PromptText(input));
+    }
+    ov::genai::EncodedInputs inputs = EncodedInputsFromTypedArray(input.As<Napi::TypedArray>(), options);
+    ov::Tensor ids;
+    if (auto *tokenized = std::get_if<ov::genai::TokenizedInputs>(&inputs))
+    {
+        const int64_t *mask = tokenized->attention_mask.data<int64_t>();
+        if (std::count(mask, mask + tokenized->attention_mask.get_size(), 0) > 0)
+        {
+            throw std::invalid_argument("Padded attention masks are not supported with a graph top-k or native decoding options");
+        }
+        ids = tokenized->input_ids;
+    }
+    else
+    {
+        ids = std::get<ov::Tensor>(inputs);
+    }
+    return std::vector<int64_t>(ids.data<int64_t>(), ids.data<int64_t>() + ids.get_size());
+}
+
+// Everything but the prompt, whose tokenization is timed separately
+static ovllm::Request RequestFromOptions(Napi::Env env, const Napi::Object &options)
+{
+    ovllm::Request request;
+    request.id = ++lastRequestId;
+    request.config = GenerationConfigFromOptions(options);
+    request.prompt_lookup = PromptLookupFromOptions(options);
+    request.grammar = GrammarFromOptions(env, options);
+    request.logit_bias = LogitBiasFromOptions(options);
+    if (options.Has("seed"))
+    {
+        request.seed = options.Get("seed").As<Napi::Number>().Int64Value();
+    }
+    if (options.Has("tenant"))
+    {
+        request.tenant = options.Get("tenant").As<Napi::String>().Utf8Value();
+    }
+    if (options.Has("priority"))
+    {
+        request.priority = options.Get("priority").As<Napi::Number>().Int32Value();
+    }
+    return request;
+}
+
+// Runs a request on the addon's own decode loop, every generated token goes through the streamer
+static ovllm::Result GenerateWithStreamer(ovllm::Request &request, ov::genai::StreamerBase &streamer)
+{
+    request.on_token = [&streamer](int64_t token)
+    {
+        return streamer.put(token);
+    };
+    ovllm::Result result = engine->generate(*session, request);
+    streamer.end();
+    return result;
+}
+
+// Generates on the genai pipeline, or on the addon's own decode loop when the options need it (prompt
+// lookup, grammars, logit bias, seeds) or there is no pipeline (graph top-k). Generated tokens go
+// through the streamer and are stamped on the timer.
+static ovllm::Result RunGeneration(Napi::Env env, const Napi::Value &input, const Napi::Object &options,
+                                   std::shared_ptr<ov::genai::StreamerBase> streamer, ovllm::GenerationTimer &timer,
+                                   const std::vector<int64_t> *prompt = nullptr)
+{
+    auto timed = std::make_shared<ovllm::TimedStreamer>(std::move(streamer), timer);
+    if (pipe == nullptr || UsesNativeDecoding(options))
+    {
+        ovllm::Request request = RequestFromOptions(env, options);
+        if (prompt != nullptr)
+        {
+            request.prompt = *prompt;
+        }
+        else
+        {
+            ovllm::trace::Span span("tokenize", request.id);
+            request.prompt = PromptFromInput(input, options);
+        }
+        timer.tokenized();
+        return GenerateWithStreamer(request, *timed);
+    }
+
+    ov::genai::GenerationConfig config = GenerationConfigFromOptions(options);
+    ovllm::Result result;
+    ovllm::GenerationStats &stats = result.stats;
+    if (streaming && IsTextPrompt(input))
+    {
+        // Chat mode: the pipeline applies the chat template and tokenizes the message itself, so that
+        // time counts into prefill and the prompt size is not known
+        timer.tokenized();
+        ovllm::trace::Span span("pipeline_generate");
+        pipe->generate(PromptText(input), config, timed);
+    }
+    else
+    {
+        ov::genai::EncodedInputs inputs;
+        if (prompt != nullptr)
+        {
+            ov::Tensor ids(ov::element::i64, {1, prompt->size()}, engine->allocator());
+            std::copy(prompt->begin(), prompt->end(), ids.data<int64_t>());
+            stats.prompt_tokens = prompt->size();
+            inputs = ids;
+        }
+        else if (IsTextPrompt(input))
+        {
+            ovllm::trace::Span span("tokenize");
+            ov::genai::TokenizedInputs tokenized = engine->tokenizer().encode(PromptText(input));
+            stats.prompt_tokens = tokenized.input_ids.get_size();
+            inputs = tokenized;
+        }
+        else
+        {
+            inputs = EncodedInputsFromTypedArray(input.As<Napi::TypedArray>(), options);
+            stats.prompt_tokens = input.As<Napi::TypedArray>().ElementLength();
+        }
+        timer.tokenized();
+        ovllm::trace::Span span("pipeline_generate");
+        pipe->generate(inputs, config, timed);
+    }
+    // The pipeline runs one forward pass per token
+    stats.generated_tokens = timer.tokens();
+    stats.forward_passes = stats.generated_tokens;
+    if (timed->stopped())
+    {
+        result.finish_reason = ovllm::FinishReason::stop;
+    }
+    else if (stats.generated_tokens >= config.max_new_tokens)
+    {
+        result.finish_reason = ovllm::FinishReason::length;
+    }
+    return result;
+}
+
+// Counts a generate call in the process metrics and returns its timings
+static ovllm::GenerationTimings RecordGeneration(const ovllm::GenerationTimer &timer, const ovllm::Result &result)
+{
+    ovllm::GenerationTimings timings = timer.finish();
+    ovllm::metrics().record(result.finish_reason, result.stats, timings);
+    return timings;
+}
+
+static void RecordFailure(const ovllm::GenerationTimer &timer)
+{
+    ovllm::metrics().record(ovllm::FinishReason::error, ovllm::GenerationStats(), timer.finish());
+}
+
+// Whether a call has a response key, for the response cache and coalescing: not in chat mode, whose output
+// depends on the history, nor with a padded batch or the per-call opt-out cache: false
+static bool HasResponseKey(const Napi::Value &input, const Napi::Object &options)
+{
+    if ((pipe != nullptr && streaming && IsTextPrompt(input)) || options.Has("attentionMask"))
+    {
+        return false;
+    }
+    if (!options.Has("cache"))
+    {
+        return true;
+    }
+    Napi::Value cache = options.Get("cache");
+    if (!cache.IsBoolean())
+    {
+        throw std::invalid_argument("Expected cache to be a boolean");
+    }
+    return cache.As<Napi::Boolean>().Value();
+}
+
+// Response cache key of a deterministic request: the model, the config fields and options that change
+// the output, and the prompt ids. Nothing for sampling without a seed.
+static std::optional<std::string> ResponseCacheKey(Napi::Env env, const Napi::Object &options, const std::vector<int64_t> &prompt)
+{
+    const ov::genai::GenerationConfig config = GenerationConfigFromOptions(options);
+    std::optional<uint64_t> seed;
+    if (options.Has("seed"))
+    {
+        seed = options.Get("seed").As<Napi::Number>().Int64Value();
+    }
+    if (config.do_sample && !seed)
+    {
+        return std::nullopt;
+    }
+    ovllm::ResponseKey key;
+    key.add(modelId);
+    ovllm::add_generation_config(key, config, prompt.size(), seed);
+    for (const char *name : {"stop", "grammar", "logitBias", "bannedTokens"})
+    {
+        key.add(options.Has(name) ? JsonStringify(env, options.Get(name)) : std::string());
+    }
+    key.add(prompt.data(), prompt.size() * sizeof(int64_t));
+    return key.bytes();
+}
+
+// Serves a cached response. Its chunks go to deliver as they were streamed, until deliver returns true.
+static Napi::Value ReplayResponse(Napi::Env env, const ovllm::CachedResponse &cached, const ovllm::TextStreamer::Callback &deliver,
+                                  ovllm::GenerationTimer &timer, bool asBuffer)
+{
+    std::string text;
+    ovllm::FinishReason reason = cached.finish_reason;
+    for (uint32_t end : cached.chunk_ends)
+    {
+        const std::string chunk = cached.text.substr(text.size(), end - text.size());
+        text += chunk;
+        if (deliver(chunk))
+        {
+            if (end != cached.text.size())
+            {
+                reason = ovllm::FinishReason::stop;
+            }
+            break;
+        }
+    }
+    // Counted as a finished call, but not as generated tokens
+    ovllm::GenerationTimings timings = timer.finish();
+    ovllm::metrics().record(reason, ovllm::GenerationStats(), timings);
+    Napi::Object response = ResultToObject(env, "text", TextToValue(env, std::move(text), asBuffer), cached.stats, timings);
+    response.Get("stats").As<Napi::Object>().Set("cached", Napi::Boolean::New(env, true));
+    return response;
+}
+
+// generate and generateStream: text chunks go to the callback when there is one, which returns true to stop
+static Napi::Value GenerateText(Napi::Env env, const Napi::Value &input, const Napi::Object &options, const Napi::Function &callback)
+{
+    ovllm::GenerationTimer timer;
+    std::string text;
+    std::vector<uint32_t> chunkEnds;
+    bool callerStopped = false;
+    try
+    {
+        auto deliver = [&callback, &callerStopped, env](const std::string &chunk)
+        {
+            if (callback.IsEmpty())
+            {
+                return false;
+            }
+            ovllm::trace::Span span("js_callback");
+            Napi::Value stop = callback.Call({Napi::String::New(env, chunk)});
+            callerStopped = stop.IsBoolean() && stop.As<Napi::Boolean>().Value();
+            return callerStopped;
+        };
+
+        std::vector<int64_t> prompt;
+        std::optional<std::string> key;
+        if (responseCache != nullptr && HasResponseKey(input, options))
+        {
+            {
+                ovllm::trace::Span span("tokenize");
+                prompt = PromptFromInput(input, options);
+            }
+            timer.tokenized();
+            key = ResponseCacheKey(env, options, prompt);
+            std::shared_ptr<const ovllm::CachedResponse> cached = key ? responseCache->find(*key) : nullptr;
+            if (cached)
+            {
+                return ReplayResponse(env, *cached, deliver, timer, TextAsBufferFromOptions(options));
+            }
+        }
+
+        auto streamer = std::make_shared<ovllm::TextStreamer>(engine->tokenizer(), [&text, &chunkEnds, &deliver](const std::string &chunk)
+        {
+            text += chunk;
+            chunkEnds.push_back(uint32_t(text.size()));
+            return deliver(chunk);
+        }, StopStringsFromOptions(options));
+        ovllm::Result result = RunGeneration(env, input, options, streamer, timer, key ? &prompt : nullptr);
+        timer.detokenized(streamer->decode_time());
+        // A response the caller cut short is not the response to the request
+        if (key && !callerStopped)
+        {
+            responseCache->insert(*key, ovllm::CachedResponse{text, std::move(chunkEnds), result.stats, result.finish_reason});
+        }
+        return ResultToObject(env, "text", TextToValue(env, std::move(text), TextAsBufferFromOptions(options)), result.stats,
+                              RecordGeneration(timer, result));
+    }
+    catch (const std::exception &error)
+    {
+        RecordFailure(timer);
+        Napi::Error::New(env, error.what()).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+}
 
 Napi::Value Initialize(const Napi::CallbackInfo &info)
 {
@@ -15,14 +688,122 @@ Napi::Value Initialize(const Napi::CallbackInfo &info)
     std::string llmPath = info[0].As<Napi::String>().Utf8Value();
     std::string device = info[1].As<Napi::String>().Utf8Value();
     streaming = info[2].As<Napi::Boolean>().Value();
+    ovllm::EngineOptions engineOptions;
+    ovllm::SchedulerConfig schedulerConfig;
+    if (info.Length() > 3 && info[3].IsObject())
+    {
+        Napi::Object options = info[3].As<Napi::Object>();
+        if (options.Has("graphTopK"))
+        {
+            engineOptions.graph_top_k = options.Get("graphTopK").As<Napi::Number>().Uint32Value();
+        }
+        // Logits of every prompt position, for prompt logprobs
+        if (options.Has("fullLogits") && options.Get("fullLogits").As<Napi::Boolean>().Value())
+        {
+            engineOptions.logits_positions = 0;
+        }
+        if (options.Has("prefillChunk"))
+        {
+            engineOptions.prefill_chunk = options.Get("prefillChunk").As<Napi::Number>().Uint32Value();
+        }
+        if (options.Has("grammarMaskBudgetMb"))
+        {
+            engineOptions.grammar_mask_budget = size_t(options.Get("grammarMaskBudgetMb").As<Napi::Number>().DoubleValue() * (1 << 20));
+        }
+        if (options.Has("profileEvery"))
+        {
+            engineOptions.profile_every = options.Get("profileEvery").As<Napi::Number>().Uint32Value();
+        }
+        if (options.Has("maxSessions"))
+        {
+            schedulerConfig.max_sessions = options.Get("maxSessions").As<Napi::Number>().Uint32Value();
+        }
+        if (options.Has("kvCacheBudgetMb"))
+        {
+            schedulerConfig.kv_cache_budget = size_t(options.Get("kvCacheBudgetMb").As<Napi::Number>().DoubleValue() * (1 << 20));
+        }
+        if (options.Has("maxQueued"))
+        {
+            schedulerConfig.max_queued = options.Get("maxQueued").As<Napi::Number>().Uint32Value();
+        }
+        // { id: { weight, tokensPerSecond, burst } }
+        if (options.Has("tenants"))
+        {
+            Napi::Object tenants = options.Get("tenants").As<Napi::Object>();
+            Napi::Array ids = tenants.GetPropertyNames();
+            for (uint32_t i = 0; i < ids.Length(); ++i)
+            {
+                std::string id = ids.Get(i).As<Napi::String>().Utf8Value();
+                Napi::Object tenantOptions = tenants.Get(id).As<Napi::Object>();
+                ovllm::TenantConfig &tenant = schedulerConfig.tenants[id];
+                if (tenantOptions.Has("weight"))
+                {
+                    tenant.weight = tenantOptions.Get("weight").As<Napi::Number>().DoubleValue();
+                }
+                if (tenantOptions.Has("tokensPerSecond"))
+                {
+                    tenant.tokens_per_second = tenantOptions.Get("tokensPerSecond").As<Napi::Number>().DoubleValue();
+                }
+                if (tenantOptions.Has("burst"))
+                {
+                    tenant.burst = tenantOptions.Get("burst").As<Napi::Number>().DoubleValue();
+                }
+            }
+        }
+        if (options.Has("coalesce"))
+        {
+            coalesceRequests = options.Get("coalesce").As<Napi::Boolean>().Value();
+        }
+        if (options.Has("responseCache"))
+        {
+            Napi::Value value = options.Get("responseCache");
+            if (value.IsObject())
+            {
+                ovllm::ResponseCacheConfig cacheConfig;
+                Napi::Object cacheOptions = value.As<Napi::Object>();
+                if (cacheOptions.Has("maxMb"))
+                {
+                    cacheConfig.max_bytes = size_t(cacheOptions.Get("maxMb").As<Napi::Number>().DoubleValue() * (1 << 20));
+                }
+                if (cacheOptions.Has("ttlSeconds"))
+                {
+                    cacheConfig.ttl = std::chrono::seconds(cacheOptions.Get("ttlSeconds").As<Napi::Number>().Int64Value());
+                }
+                responseCache = new ovllm::ResponseCache(cacheConfig);
+            }
+            else if (value.As<Napi::Boolean>().Value())
+            {
+                responseCache = new ovllm::ResponseCache(ovllm::ResponseCacheConfig());
+            }
+        }
+    }
 
+    ovllm::trace::name_thread("js");
+    modelId = llmPath + "|" + device;
     std::cout << "OpenVINO LLM: " << llmPath << std::endl;
     std::cout << "Device : " << device << std::endl;
 
-    pipe = new ov::genai::LLMPipeline(llmPath, device);
-    if (streaming)
+    try
     {
-        pipe->start_chat();
+        engine = new ovllm::Engine(llmPath, device, engineOptions);
+        scheduler = new ovllm::Scheduler(*engine, schedulerConfig);
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(env, error.what()).ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+    session = engine->create_session().release();
+    // The genai pipeline shares the engine's compiled model instead of loading a second copy. It needs
+    // full logits, with a graph top-k every request runs on the engine's decode loop. So do profiled
+    // runs, whose forward passes are sampled there.
+    if (engineOptions.graph_top_k == 0 && engineOptions.profile_every == 0)
+    {
+        pipe = new ov::genai::LLMPipeline(engine->create_request(), engine->tokenizer(), engine->generation_config());
+        if (streaming)
+        {
+            pipe->start_chat();
+        }
     }
     return Napi::Boolean::New(env, true);
 }
@@ -30,27 +811,27 @@ Napi::Value Initialize(const Napi::CallbackInfo &info)
 Napi::Value Generate(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
-    if (pipe == nullptr)
+    if (engine == nullptr)
     {
         Napi::TypeError::New(env, "Pipe is not initialized").ThrowAsJavaScriptException();
         return env.Null();
     }
-    if (info.Length() < 1 || !info[0].IsString())
+    if (info.Length() < 1 || !(info[0].IsString() || info[0].IsTypedArray()))
     {
         Napi::TypeError::New(env, "Expected a prompt").ThrowAsJavaScriptException();
         return Napi::Boolean::New(env, false);
     }
-
-    std::string prompt = info[0].As<Napi::String>().Utf8Value();
-    ov::genai::GenerationConfig config;
-    config.max_new_tokens = 256;
-    std::string response = pipe->generate(prompt, config);
-    return Napi::String::New(env, response);
+    Napi::Object options = info.Length() > 1 && info[1].IsObject() ? info[1].As<Napi::Object>() : Napi::Object::New(env);
+    if (!CheckAttentionMask(env, info[0], options))
+    {
+        return Napi::Boolean::New(env, false);
+    }
+    return GenerateText(env, info[0], options, Napi::Function());
 }
 Napi::Value GenerateStream(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
-    if (pipe == nullptr)
+    if (engine == nullptr)
     {
         Napi::TypeError::New(env, "Pipe not initialized").ThrowAsJavaScriptException();
         return env.Null();
@@ -61,7 +842,7 @@ Napi::Value GenerateStream(const Napi::CallbackInfo &info)
         return Napi::Boolean::New(env, false);
     }
 
-    if (!info[0].IsString())
+    if (!IsTextPrompt(info[0]))
     {
         Napi::TypeError::New(env, "Expected a prompt").ThrowAsJavaScriptException();
         return Napi::Boolean::New(env, false);
@@ -74,40 +855,538 @@ Napi::Value GenerateStream(const Napi::CallbackInfo &info)
     }
     // Js callback
     Napi::Function callback = info[1].As<Napi::Function>();
+    Napi::Object options = info.Length() > 2 && info[2].IsObject() ? info[2].As<Napi::Object>() : Napi::Object::New(env);
+    return GenerateText(env, info[0], options, callback);
+}
+Napi::Value GenerateTokens(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (engine == nullptr)
+    {
+        Napi::TypeError::New(env, "Pipe not initialized").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (info.Length() < 2)
+    {
+        Napi::TypeError::New(env, "Expected two arguments").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+    if (!info[0].IsString() && !info[0].IsTypedArray())
+    {
+        Napi::TypeError::New(env, "Expected a prompt or a typed array of token ids").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+    if (!info[1].IsFunction())
+    {
+        Napi::TypeError::New(env, "Expected callback function as the second argument").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+    Napi::Function callback = info[1].As<Napi::Function>();
 
-    std::string prompt = info[0].As<Napi::String>().Utf8Value();
-    ov::genai::GenerationConfig config;
-    config.max_new_tokens = 256;
+    Napi::Object options = info.Length() > 2 && info[2].IsObject() ? info[2].As<Napi::Object>() : Napi::Object::New(env);
+    if (!CheckAttentionMask(env, info[0], options))
+    {
+        return Napi::Boolean::New(env, false);
+    }
+    size_t chunkSize = 16;
+    if (options.Has("chunkSize"))
+    {
+        chunkSize = options.Get("chunkSize").As<Napi::Number>().Uint32Value();
+    }
 
-    std::function<bool(std::string)> streamer = [callback, env](std::string word)
+    ovllm::GenerationTimer timer;
+    std::vector<int32_t> tokens;
+    try
     {
-        callback.Call(env.Global(), {Napi::String::New(env, word)});
-        return false;
-    };
+        // Ids cross into JS a chunk at a time as one typed array, no per-token strings
+        auto streamer = std::make_shared<ovllm::TokenStreamer>(chunkSize, [&tokens, callback, env](const int32_t *chunkTokens, size_t count)
+        {
+            tokens.insert(tokens.end(), chunkTokens, chunkTokens + count);
+            Napi::Int32Array chunk = Napi::Int32Array::New(env, count);
+            std::copy_n(chunkTokens, count, chunk.Data());
+            ovllm::trace::Span span("js_callback");
+            callback.Call({chunk});
+            return false;
+        });
+        ovllm::Result result = RunGeneration(env, info[0], options, streamer, timer);
 
-    pipe->generate(prompt, config, streamer);
-    return Napi::Boolean::New(env, true);
+        Napi::Int32Array response = Napi::Int32Array::New(env, tokens.size());
+        std::copy(tokens.begin(), tokens.end(), response.Data());
+        return ResultToObject(env, "tokens", response, result.stats, RecordGeneration(timer, result));
+    }
+    catch (const std::exception &error)
+    {
+        RecordFailure(timer);
+        Napi::Error::New(env, error.what()).ThrowAsJavaScriptException();
+        return env.Null();
+    }
 }
+// A caller of generateAsync. Identical concurrent calls share one generation, each caller subscribes to
+// its text.
+struct AsyncSubscriber
+{
+    explicit AsyncSubscriber(Napi::Env env) : deferred(Napi::Promise::Deferred::New(env)) {}
+
+    Napi::Promise::Deferred deferred;
+    Napi::FunctionReference onChunk;
+    bool textAsBuffer = false;
+    // Length of the shared text when the callback returned true, it receives no more chunks after
+    std::optional<size_t> stoppedAt;
+    // Tokens of the first subscriber's timer are stamped on the scheduler thread, finish() runs on the
+    // JS thread after the last of them
+    ovllm::GenerationTimer timer;
+};
+
+// A generateAsync generation. The scheduler thread only samples token ids, they are detokenized on the
+// JS thread, which owns the tokenizer.
+struct AsyncGeneration
+{
+    Napi::ThreadSafeFunction tsfn;
+    std::unique_ptr<ovllm::TextStreamer> streamer;
+    // The first subscriber started the generation, identical calls attach while it runs
+    std::vector<std::unique_ptr<AsyncSubscriber>> subscribers;
+    std::string text;
+    // Text detokenized since the last callbacks, which receive it as one string
+    std::string chunk;
+    std::vector<uint32_t> chunkEnds;
+    // Set when every subscriber's callback stopped generation
+    bool callerStopped = false;
+    std::optional<std::string> cacheKey;
+    // Tokens from the scheduler thread not yet delivered. One call on the JS thread drains all that
+    // arrived while it was queued, so a busy event loop sees fewer, larger chunks.
+    std::mutex mutex;
+    std::vector<int64_t> pending;
+    // Set on the JS thread by a stop string or the callbacks, read by the scheduler thread
+    std::atomic<bool> stop{false};
+};
+
+// Generations that identical calls can attach to, by response key. JS thread only.
+static std::map<std::string, std::shared_ptr<AsyncGeneration>> inFlight;
+
+static void LeaveInFlight(const AsyncGeneration &generation)
+{
+    if (!generation.cacheKey)
+    {
+        return;
+    }
+    auto flight = inFlight.find(*generation.cacheKey);
+    if (flight != inFlight.end() && flight->second.get() == &generation)
+    {
+        inFlight.erase(flight);
+    }
+}
+
+// Passes the text detokenized since the last call to the subscribers still listening. Generation stops
+// once every callback has returned true.
+static void FlushAsyncChunk(Napi::Env env, AsyncGeneration &generation)
+{
+    if (generation.chunk.empty())
+    {
+        return;
+    }
+    Napi::String chunk;
+    bool listening = false;
+    for (const std::unique_ptr<AsyncSubscriber> &subscriber : generation.subscribers)
+    {
+        if (subscriber->stoppedAt)
+        {
+            continue;
+        }
+        if (subscriber->onChunk.IsEmpty())
+        {
+            listening = true;
+            continue;
+        }
+        if (chunk.IsEmpty())
+        {
+            chunk = Napi::String::New(env, generation.chunk);
+        }
+        ovllm::trace::Span span("js_callback");
+        Napi::Value stop = subscriber->onChunk.Call({chunk});
+        if (stop.IsBoolean() && stop.As<Napi::Boolean>().Value())
+        {
+            subscriber->stoppedAt = generation.text.size();
+        }
+        else
+        {
+            listening = true;
+        }
+    }
+    generation.chunk.clear();
+    if (!listening)
+    {
+        generation.stop = true;
+        generation.callerStopped = true;
+        // A cut short stream is no answer for later identical calls
+        LeaveInFlight(generation);
+    }
+}
+
+// Attaches a call to an identical generation in flight. It receives the text streamed so far at once,
+// then the rest with the other subscribers.
+static void JoinInFlight(Napi::Env env, AsyncGeneration &generation, std::unique_ptr<AsyncSubscriber> subscriber)
+{
+    // The pending chunk goes out with the next flush
+    const size_t delivered = generation.text.size() - generation.chunk.size();
+    size_t begin = 0;
+    for (uint32_t end : generation.chunkEnds)
+    {
+        if (end > delivered || subscriber->onChunk.IsEmpty())
+        {
+            break;
+        }
+        Napi::Value stop = subscriber->onChunk.Call({Napi::String::New(env, generation.text.substr(begin, end - begin))});
+        if (stop.IsBoolean() && stop.As<Napi::Boolean>().Value())
+        {
+            subscriber->stoppedAt = end;
+            break;
+        }
+        begin = end;
+    }
+    generation.subscribers.push_back(std::move(subscriber));
+}
+
+// Resolves every subscriber with the text it listened to. The first one counts as the generate call in
+// the metrics, the others as calls without generated tokens.
+static void ResolveSubscribers(Napi::Env env, AsyncGeneration &generation, const ovllm::Result &result)
+{
+    for (size_t i = 0; i < generation.subscribers.size(); ++i)
+    {
+        AsyncSubscriber &subscriber = *generation.subscribers[i];
+        ovllm::Result own;
+        own.stats = result.stats;
+        own.finish_reason = subscriber.stoppedAt ? ovllm::FinishReason::stop : result.finish_reason;
+        std::string text = generation.text.substr(0, subscriber.stoppedAt.value_or(generation.text.size()));
+        ovllm::GenerationTimings timings;
+        if (i == 0)
+        {
+            subscriber.timer.detokenized(generation.streamer->decode_time());
+            timings = RecordGeneration(subscriber.timer, own);
+        }
+        else
+        {
+            timings = subscriber.timer.finish();
+            ovllm::metrics().record(own.finish_reason, ovllm::GenerationStats(), timings);
+        }
+        Napi::Object response = ResultToObject(env, "text", TextToValue(env, std::move(text), subscriber.textAsBuffer), result.stats, timings);
+        if (i > 0)
+        {
+            response.Get("stats").As<Napi::Object>().Set("coalesced", Napi::Boolean::New(env, true));
+        }
+        subscriber.deferred.Resolve(response);
+    }
+}
+
+Napi::Value GenerateAsync(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (scheduler == nullptr)
+    {
+        Napi::TypeError::New(env, "Pipe not initialized").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (info.Length() < 1 || !(info[0].IsString() || info[0].IsTypedArray()))
+    {
+        Napi::TypeError::New(env, "Expected a prompt").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Object options = info.Length() > 1 && info[1].IsObject() ? info[1].As<Napi::Object>() : Napi::Object::New(env);
+    if (!CheckAttentionMask(env, info[0], options))
+    {
+        return env.Null();
+    }
+    auto subscriber = std::make_unique<AsyncSubscriber>(env);
+    if (info.Length() > 2 && info[2].IsFunction())
+    {
+        subscriber->onChunk = Napi::Persistent(info[2].As<Napi::Function>());
+    }
+    subscriber->textAsBuffer = TextAsBufferFromOptions(options);
+    // The subscriber moves into a generation, the promise and timer stay reachable
+    const Napi::Promise::Deferred deferred = subscriber->deferred;
+    ovllm::GenerationTimer *timer = &subscriber->timer;
+
+    auto state = std::make_shared<AsyncGeneration>();
+    AsyncGeneration *raw = state.get();
+    bool hasTsfn = false;
+    try
+    {
+        ovllm::Request request = RequestFromOptions(env, options);
+        {
+            ovllm::trace::Span span("tokenize", request.id);
+            request.prompt = PromptFromInput(info[0], options);
+        }
+        timer->tokenized();
+        if ((responseCache != nullptr || coalesceRequests) && HasResponseKey(info[0], options))
+        {
+            state->cacheKey = ResponseCacheKey(env, options, request.prompt);
+        }
+        if (state->cacheKey && responseCache != nullptr)
+        {
+            std::shared_ptr<const ovllm::CachedResponse> cached = responseCache->find(*state->cacheKey);
+            if (cached)
+            {
+                // Replayed to the callback before the promise resolves
+                AsyncSubscriber *caller = subscriber.get();
+                auto deliver = [caller, env](const std::string &chunk)
+                {
+                    if (caller->onChunk.IsEmpty())
+                    {
+                        return false;
+                    }
+                    Napi::Value stop = caller->onChunk.Call({Napi::String::New(env, chunk)});
+                    return stop.IsBoolean() && stop.As<Napi::Boolean>().Value();
+                };
+                deferred.Resolve(ReplayResponse(env, *cached, deliver, *timer, caller->textAsBuffer));
+                return deferred.Promise();
+            }
+        }
+        if (state->cacheKey && coalesceRequests)
+        {
+            auto flight = inFlight.find(*state->cacheKey);
+            if (flight != inFlight.end())
+            {
+                ovllm::metrics().coalesced_requests.fetch_add(1, std::memory_order_relaxed);
+                JoinInFlight(env, *flight->second, std::move(subscriber));
+                return deferred.Promise();
+            }
+        }
+
+        state->streamer = std::make_unique<ovllm::TextStreamer>(engine->tokenizer(), [raw](const std::string &chunk)
+        {
+            raw->text += chunk;
+            raw->chunk += chunk;
+            raw->chunkEnds.push_back(uint32_t(raw->text.size()));
+            return false;
+        }, StopStringsFromOptions(options));
+        state->subscribers.push_back(std::move(subscriber));
+
+        const uint64_t id = request.id;
+        state->tsfn = Napi::ThreadSafeFunction::New(env, Napi::Function::New(env, [](const Napi::CallbackInfo &) {}), "ovllm.generateAsync", 0, 1);
+        hasTsfn = true;
+        request.on_token = [state, timer, id](int64_t token)
+        {
+            timer->token();
+            bool first = false;
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->pending.push_back(token);
+                first = state->pending.size() == 1;
+            }
+            if (first)
+            {
+                state->tsfn.NonBlockingCall([state, id](Napi::Env env, Napi::Function)
+                {
+                    // Delivery of tokens on the JS thread, detokenization and the callbacks nest inside
+                    ovllm::trace::Span span("deliver_token", id);
+                    std::vector<int64_t> tokens;
+                    {
+                        std::lock_guard<std::mutex> lock(state->mutex);
+                        tokens.swap(state->pending);
+                    }
+                    for (int64_t token : tokens)
+                    {
+                        if (!state->stop && state->streamer->put(token))
+                        {
+                            state->stop = true;
+                        }
+                    }
+                    FlushAsyncChunk(env, *state);
+                });
+            }
+            return state->stop.load();
+        };
+        scheduler->submit(std::move(request), [state](ovllm::Result &&result, std::exception_ptr error)
+        {
+            std::string message;
+            if (error)
+            {
+                try
+                {
+                    std::rethrow_exception(error);
+                }
+                catch (const std::exception &exception)
+                {
+                    message = exception.what();
+                }
+            }
+            result.tokens.clear();
+            state->tsfn.NonBlockingCall([state, result, error, message](Napi::Env env, Napi::Function)
+            {
+                LeaveInFlight(*state);
+                if (error)
+                {
+                    RecordFailure(state->subscribers.front()->timer);
+                    for (const std::unique_ptr<AsyncSubscriber> &subscriber : state->subscribers)
+                    {
+                        subscriber->deferred.Reject(Napi::Error::New(env, message).Value());
+                    }
+                    return;
+                }
+                state->streamer->end();
+                FlushAsyncChunk(env, *state);
+                // The cache is gone when cleanup ran while this completion was queued
+                if (state->cacheKey && !state->callerStopped && responseCache != nullptr)
+                {
+                    responseCache->insert(*state->cacheKey, ovllm::CachedResponse{state->text, state->chunkEnds, result.stats,
+                                                                                 result.finish_reason});
+                }
+                ResolveSubscribers(env, *state, result);
+            });
+            state->tsfn.Release();
+        });
+        if (state->cacheKey && coalesceRequests)
+        {
+            inFlight[*state->cacheKey] = state;
+        }
+    }
+    catch (const std::exception &error)
+    {
+        // A rejected submit never completes, the thread-safe function would keep the event loop alive
+        if (hasTsfn)
+        {
+            state->tsfn.Release();
+        }
+        RecordFailure(*timer);
+        deferred.Reject(Napi::Error::New(env, error.what()).Value());
+    }
+    return deferred.Promise();
+}
+
 Napi::Value Cleanup(const Napi::CallbackInfo &info)
 {
-    if (streaming)
+    if (streaming && pipe != nullptr)
     {
         pipe->finish_chat();
     }
     Napi::Env env = info.Env();
+    // Rejects pending generateAsync calls and stops using the engine before it goes away
+    if (scheduler != nullptr)
+    {
+        delete scheduler;
+        scheduler = nullptr;
+    }
     if (pipe != nullptr)
     {
         delete pipe;
         pipe = nullptr;
     }
+    if (session != nullptr)
+    {
+        delete session;
+        session = nullptr;
+    }
+    grammars.clear();
+    inFlight.clear();
+    if (responseCache != nullptr)
+    {
+        responseCache->clear();
+        delete responseCache;
+        responseCache = nullptr;
+    }
+    if (engine != nullptr)
+    {
+        delete engine;
+        engine = nullptr;
+    }
     return Napi::Boolean::New(env, true);
 }
 
+// Writes the profiling report to path.txt and path.csv, returns the report
+Napi::Value WriteProfile(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (engine == nullptr || engine->profiler() == nullptr)
+    {
+        Napi::Error::New(env, "Profiling is not enabled, initialize with profileEvery").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (info.Length() < 1 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "Expected an output path").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    try
+    {
+        engine->profiler()->write(info[0].As<Napi::String>().Utf8Value());
+        return Napi::String::New(env, engine->profiler()->report());
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(env, error.what()).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+}
+
+Napi::Value StartTrace(const Napi::CallbackInfo &info)
+{
+    ovllm::trace::start();
+    return Napi::Boolean::New(info.Env(), true);
+}
+
+// Stops tracing and returns the Chrome Trace Event JSON, which is also written to the path when given
+Napi::Value StopTrace(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    std::string json = ovllm::trace::stop();
+    if (info.Length() > 0 && info[0].IsString())
+    {
+        std::string path = info[0].As<Napi::String>().Utf8Value();
+        std::ofstream file(path, std::ios::binary);
+        file << json;
+        if (!file)
+        {
+            Napi::Error::New(env, "Cannot write " + path).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
+    return Napi::String::New(env, json);
+}
+
+// Token ids of a string as an Int32Array, which generate functions accept as a prompt
+Napi::Value Tokenize(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (engine == nullptr)
+    {
+        Napi::TypeError::New(env, "Pipe is not initialized").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (info.Length() < 1 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "Expected a string").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    try
+    {
+        std::vector<int64_t> tokens = engine->encode(info[0].As<Napi::String>().Utf8Value());
+        Napi::Int32Array ids = Napi::Int32Array::New(env, tokens.size());
+        std::copy(tokens.begin(), tokens.end(), ids.Data());
+        return ids;
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(env, error.what()).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+}
+
+Napi::Value Metrics(const Napi::CallbackInfo &info)
+{
+    return Napi::String::New(info.Env(), ovllm::metrics().prometheus());
+}
+
 Napi::Object Init(Napi::Env env, Napi::Object exports)
 {
     exports.Set(Napi::String::New(env, "initialize"), Napi::Function::New(env, Initialize));
     exports.Set(Napi::String::New(env, "generate"), Napi::Function::New(env, Generate));
     exports.Set(Napi::String::New(env, "generateStream"), Napi::Function::New(env, GenerateStream));
+    exports.Set(Napi::String::New(env, "generateTokens"), Napi::Function::New(env, GenerateTokens));
+    exports.Set(Napi::String::New(env, "generateAsync"), Napi::Function::New(env, GenerateAsync));
+    exports.Set(Napi::String::New(env, "tokenize"), Napi::Function::New(env, Tokenize));
+    exports.Set(Napi::String::New(env, "metrics"), Napi::Function::New(env, Metrics));
+    exports.Set(Napi::String::New(env, "writeProfile"), Napi::Function::New(env, WriteProfile));
+    exports.Set(Napi::String::New(env, "startTrace"), Napi::Function::New(env, StartTrace));
+    exports.Set(Napi::String::New(env, "stopTrace"), Napi::Function::New(env, StopTrace));
     exports.Set(Napi::String::New(env, "cleanup"), Napi::Function::New(env, Cleanup));
     return exports;
 }
@@ -0,0 +1,104 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace ovllm
+{
+    static const char *phase_name(Profiler::Phase phase)
+    {
+        return phase == Profiler::Phase::prefill ? "prefill" : "decode";
+    }
+
+    Profiler::Profiler(size_t sample_every) : m_sample_every(std::max<size_t>(sample_every, 1))
+    {
+    }
+
+    bool Profiler::sample(Phase phase)
+    {
+        return m_passes[size_t(phase)].fetch_add(1, std::memory_order_relaxed) % m_sample_every == 0;
+    }
+
+    void Profiler::add(Phase phase, const std::vector<ov::ProfilingInfo> &nodes)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_samples[size_t(phase)];
+        for (const ov::ProfilingInfo &node : nodes)
+        {
+            if (node.status != ov::ProfilingInfo::Status::EXECUTED)
+            {
+                continue;
+            }
+            Totals &totals = m_totals[Key(phase, node.node_type, node.exec_type)];
+            ++totals.calls;
+            totals.real_us += node.real_time.count();
+            totals.cpu_us += node.cpu_time.count();
+        }
+    }
+
+    std::vector<std::pair<Profiler::Key, Profiler::Totals>> Profiler::sorted() const
+    {
+        std::vector<std::pair<Key, Totals>> rows(m_totals.begin(), m_totals.end());
+        std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b)
+        {
+            return a.second.real_us > b.second.real_us;
+        });
+        return rows;
+    }
+
+    std::string Profiler::report() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        int64_t phase_us[2] = {};
+        for (const auto &[key, totals] : m_totals)
+        {
+            phase_us[size_t(std::get<0>(key))] += totals.real_us;
+        }
+
+        std::string out;
+        char line[512];
+        std::snprintf(line, sizeof(line), "Sampled passes: %zu prefill, %zu decode\n\n", m_samples[0], m_samples[1]);
+        out += line;
+        std::snprintf(line, sizeof(line), "%-8s %-28s %-32s %8s %12s %12s %7s\n", "phase", "node type", "exec type", "calls",
+                      "real ms", "cpu ms", "share");
+        out += line;
+        for (const auto &[key, totals] : sorted())
+        {
+            const auto &[phase, node_type, exec_type] = key;
+            const int64_t total = phase_us[size_t(phase)];
+            std::snprintf(line, sizeof(line), "%-8s %-28s %-32s %8zu %12.3f %12.3f %6.1f%%\n", phase_name(phase),
+                          node_type.c_str(), exec_type.c_str(), totals.calls, totals.real_us / 1000.0, totals.cpu_us / 1000.0,
+                          total ? 100.0 * totals.real_us / total : 0.0);
+            out += line;
+        }
+        return out;
+    }
+
+    std::string Profiler::csv() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string out = "phase,node_type,exec_type,calls,real_us,cpu_us\n";
+        for (const auto &[key, totals] : sorted())
+        {
+            const auto &[phase, node_type, exec_type] = key;
+            out += std::string(phase_name(phase)) + "," + node_type + "," + exec_type + "," + std::to_string(totals.calls) + "," +
+                   std::to_string(totals.real_us) + "," + std::to_string(totals.cpu_us) + "\n";
+        }
+        return out;
+    }
+
+    void Profiler::write(const std::string &path) const
+    {
+        for (const auto &[extension, text] : {std::make_pair(".txt", report()), std::make_pair(".csv", csv())})
+        {
+            std::ofstream file(path + extension, std::ios::binary);
+            file << text;
+            if (!file)
+            {
+                throw std::runtime_error("Cannot write " + path + extension);
+            }
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "openvino/runtime/profiling_info.hpp"
+
+namespace ovllm
+{
+    // Aggregates per-node profiling counters of sampled forward passes by node type and kernel, to
+    // spot unfused ops and slow kernels. Needs a model compiled with ov::enable_profiling(true).
+    class Profiler
+    {
+    public:
+        enum class Phase
+        {
+            prefill,
+            decode,
+        };
+
+        // Profiles one in sample_every forward passes of each phase.
+        explicit Profiler(size_t sample_every);
+
+        // Whether the next forward pass of the phase is to be profiled, called once per pass.
+        bool sample(Phase phase);
+        void add(Phase phase, const std::vector<ov::ProfilingInfo> &nodes);
+
+        // Rows sorted by descending real time.
+        std::string report() const;
+        std::string csv() const;
+        // Writes the report to path.txt and the CSV to path.csv.
+        void write(const std::string &path) const;
+
+    private:
+        struct Totals
+        {
+            size_t calls = 0;
+            int64_t real_us = 0;
+            int64_t cpu_us = 0;
+        };
+        using Key = std::tuple<Phase, std::string, std::string>;
+
+        // Callers hold m_mutex
+        std::vector<std::pair<Key, Totals>> sorted() const;
+
+        size_t m_sample_every;
+        std::atomic<size_t> m_passes[2] = {};
+
+        mutable std::mutex m_mutex;
+        std::map<Key, Totals> m_totals;
+        size_t m_samples[2] = {};
+    };
+}
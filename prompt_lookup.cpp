@@ -0,0 +1,31 @@
+#include "prompt_lookup.hpp"
+
+#include <algorithm>
+
+namespace ovllm
+{
+    std::vector<int64_t> find_candidates(const std::vector<int64_t> &tokens, const PromptLookupConfig &config)
+    {
+        const size_t length = tokens.size();
+        for (size_t ngram = std::min(config.max_ngram_size, length - 1); ngram > 0 && length > ngram; --ngram)
+        {
+            const auto suffix = tokens.end() - ngram;
+            // Latest occurrence first: recent context is the most likely to be copied again
+            for (size_t start = length - ngram; start-- > 0;)
+            {
+                if (!std::equal(suffix, tokens.end(), tokens.begin() + start))
+                {
+                    continue;
+                }
+                const size_t from = start + ngram;
+                const size_t count = std::min(config.num_candidates, length - from);
+                if (count == 0)
+                {
+                    continue;
+                }
+                return std::vector<int64_t>(tokens.begin() + from, tokens.begin() + from + count);
+            }
+        }
+        return {};
+    }
+}
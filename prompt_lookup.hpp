@@ -0,0 +1,12 @@
+#pragma once
+
+#include <vector>
+
+#include "engine.hpp"
+
+namespace ovllm
+{
+    // Finds the longest suffix n-gram (max_ngram_size down to 1) of tokens earlier in tokens and
+    // returns up to num_candidates tokens that followed it. Empty when there is no match.
+    std::vector<int64_t> find_candidates(const std::vector<int64_t> &tokens, const PromptLookupConfig &config);
+}
@@ -0,0 +1,87 @@
+#include "response_cache.hpp"
+
+#include "metrics.hpp"
+
+namespace ovllm
+{
+    void add_generation_config(ResponseKey &key, const ov::genai::GenerationConfig &config, size_t prompt_tokens,
+                               const std::optional<uint64_t> &seed)
+    {
+        key.add(uint64_t(config.get_max_new_tokens(prompt_tokens)));
+        key.add(config.ignore_eos);
+        key.add(int64_t(config.eos_token_id));
+        key.add(config.repetition_penalty);
+        key.add(config.do_sample);
+        // Sampling parameters only matter to seeded sampling, greedy requests that differ in them are the same
+        if (config.do_sample)
+        {
+            key.add(config.temperature);
+            key.add(uint64_t(config.top_k));
+            key.add(config.top_p);
+            key.add(seed.value_or(0));
+        }
+    }
+
+    std::shared_ptr<const CachedResponse> ResponseCache::find(const std::string &key)
+    {
+        Metrics &counters = metrics();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_index.find(key);
+        if (found == m_index.end())
+        {
+            counters.response_cache_misses.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        if (std::chrono::steady_clock::now() >= found->second->expires)
+        {
+            erase(found->second);
+            counters.response_cache_misses.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        m_entries.splice(m_entries.begin(), m_entries, found->second);
+        counters.response_cache_hits.fetch_add(1, std::memory_order_relaxed);
+        return found->second->response;
+    }
+
+    void ResponseCache::insert(const std::string &key, CachedResponse response)
+    {
+        const size_t bytes = sizeof(Entry) + sizeof(CachedResponse) + key.size() + response.text.size() +
+                             response.chunk_ends.size() * sizeof(uint32_t);
+        if (bytes > m_config.max_bytes)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_index.find(key);
+        if (found != m_index.end())
+        {
+            erase(found->second);
+        }
+        while (!m_entries.empty() && m_bytes + bytes > m_config.max_bytes)
+        {
+            erase(std::prev(m_entries.end()));
+        }
+        m_entries.push_front(Entry{key, std::make_shared<const CachedResponse>(std::move(response)), bytes,
+                                   std::chrono::steady_clock::now() + m_config.ttl});
+        m_index.emplace(m_entries.front().key, m_entries.begin());
+        m_bytes += bytes;
+        metrics().response_cache_bytes.fetch_add(int64_t(bytes), std::memory_order_relaxed);
+    }
+
+    void ResponseCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        metrics().response_cache_bytes.fetch_sub(int64_t(m_bytes), std::memory_order_relaxed);
+        m_entries.clear();
+        m_index.clear();
+        m_bytes = 0;
+    }
+
+    void ResponseCache::erase(std::list<Entry>::iterator entry)
+    {
+        m_bytes -= entry->bytes;
+        metrics().response_cache_bytes.fetch_sub(int64_t(entry->bytes), std::memory_order_relaxed);
+        m_index.erase(entry->key);
+        m_entries.erase(entry);
+    }
+}
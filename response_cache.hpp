@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "engine.hpp"
+
+namespace ovllm
+{
+    // Serialized fields that decide a response. Entries compare the whole key, so two requests never
+    // share a response because their hashes collide.
+    class ResponseKey
+    {
+    public:
+        void add(const void *data, size_t size) { m_bytes.append(static_cast<const char *>(data), size); }
+        template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+        void add(T value) { add(&value, sizeof(value)); }
+        // Length prefixed, so that consecutive strings cannot run into each other
+        void add(const std::string &text)
+        {
+            add(uint64_t(text.size()));
+            add(text.data(), text.size());
+        }
+        const std::string &bytes() const { return m_bytes; }
+
+    private:
+        std::string m_bytes;
+    };
+
+    // Adds the generation config fields that change the output of a deterministic request.
+    void add_generation_config(ResponseKey &key, const ov::genai::GenerationConfig &config, size_t prompt_tokens,
+                               const std::optional<uint64_t> &seed);
+
+    struct ResponseCacheConfig
+    {
+        size_t max_bytes = size_t(64) << 20;
+        std::chrono::seconds ttl{600};
+    };
+
+    // A finished response: the text with the boundaries of the chunks it was streamed in, so that a
+    // hit can be replayed to a streaming callback.
+    struct CachedResponse
+    {
+        std::string text;
+        std::vector<uint32_t> chunk_ends;
+        GenerationStats stats;
+        FinishReason finish_reason = FinishReason::eos;
+    };
+
+    // LRU cache of responses to deterministic requests, by serialized key. Entries expire after the TTL, and
+    // the least recently used are evicted past the byte budget. Safe to use from any thread.
+    class ResponseCache
+    {
+    public:
+        explicit ResponseCache(const ResponseCacheConfig &config) : m_config(config) {}
+
+        // Null on a miss or an expired entry.
+        std::shared_ptr<const CachedResponse> find(const std::string &key);
+        void insert(const std::string &key, CachedResponse response);
+        void clear();
+
+    private:
+        struct Entry
+        {
+            std::string key;
+            std::shared_ptr<const CachedResponse> response;
+            size_t bytes;
+            std::chrono::steady_clock::time_point expires;
+        };
+
+        void erase(std::list<Entry>::iterator entry);
+
+        ResponseCacheConfig m_config;
+        std::mutex m_mutex;
+        // Most recently used first
+        std::list<Entry> m_entries;
+        // Views of the keys held by the entries
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> m_index;
+        size_t m_bytes = 0;
+    };
+}
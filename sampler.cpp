@@ -0,0 +1,483 @@
+#include "sampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+#include "cpu_features.hpp"
+
+namespace ovllm
+{
+    // Candidates taken for top-p without top-k, grown until they cover top_p of the probability mass
+    static constexpr size_t kInitialTopP = 256;
+    // Largest k selected with a heap, larger ones use nth_element over a copy
+    static constexpr size_t kHeapSelection = 1024;
+
+#if defined(OVLLM_X86)
+    // exp(x) for 8 lanes, Cephes polynomial as in avx_mathfun, relative error around 1e-7
+    OVLLM_TARGET("avx2") static inline __m256 exp256(__m256 x)
+    {
+        x = _mm256_min_ps(x, _mm256_set1_ps(88.3762626647949f));
+        x = _mm256_max_ps(x, _mm256_set1_ps(-88.3762626647949f));
+
+        __m256 fx = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)), _mm256_set1_ps(0.5f));
+        fx = _mm256_floor_ps(fx);
+        x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(0.693359375f)));
+        x = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(-2.12194440e-4f)));
+
+        __m256 y = _mm256_set1_ps(1.9875691500E-4f);
+        y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.3981999507E-3f));
+        y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(8.3334519073E-3f));
+        y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(4.1665795894E-2f));
+        y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.6666665459E-1f));
+        y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(5.0000001201E-1f));
+        y = _mm256_add_ps(_mm256_mul_ps(y, _mm256_mul_ps(x, x)), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+
+        __m256i n = _mm256_cvttps_epi32(fx);
+        n = _mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23);
+        return _mm256_mul_ps(y, _mm256_castsi256_ps(n));
+    }
+
+    OVLLM_TARGET("avx2") static inline float horizontal_max(__m256 v)
+    {
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, v);
+        return *std::max_element(lanes, lanes + 8);
+    }
+
+    OVLLM_TARGET("avx2") static inline float horizontal_sum(__m256 v)
+    {
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, v);
+        float sum = 0.0f;
+        for (float lane : lanes)
+        {
+            sum += lane;
+        }
+        return sum;
+    }
+
+    // The kernels below cover whole vectors from i and advance it, the callers finish the tail.
+
+#if defined(__GNUC__) && !defined(__clang__)
+    // GCC before 12.3 warns about the undefined source operands inside the AVX-512 intrinsics (PR 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+    OVLLM_TARGET("avx512f") static float max_value_avx512(const float *values, size_t size, size_t &i, float best)
+    {
+        __m512 wide = _mm512_set1_ps(best);
+        for (; i + 16 <= size; i += 16)
+        {
+            wide = _mm512_max_ps(wide, _mm512_loadu_ps(values + i));
+        }
+        return _mm512_reduce_max_ps(wide);
+    }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+    OVLLM_TARGET("avx2") static float max_value_avx2(const float *values, size_t size, size_t &i, float best)
+    {
+        __m256 wide = _mm256_set1_ps(best);
+        for (; i + 8 <= size; i += 8)
+        {
+            wide = _mm256_max_ps(wide, _mm256_loadu_ps(values + i));
+        }
+        return horizontal_max(wide);
+    }
+
+    // Returns true with i at the first vector holding target
+    OVLLM_TARGET("avx2") static bool find_avx2(const float *values, size_t size, size_t &i, float target)
+    {
+        const __m256 wide = _mm256_set1_ps(target);
+        for (; i + 8 <= size; i += 8)
+        {
+            int found = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(values + i), wide, _CMP_EQ_OQ));
+            if (found != 0)
+            {
+                while (!(found & 1))
+                {
+                    found >>= 1;
+                    ++i;
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    OVLLM_TARGET("avx512f") static void scale_avx512(float *values, size_t size, size_t &i, float factor)
+    {
+        const __m512 wide = _mm512_set1_ps(factor);
+        for (; i + 16 <= size; i += 16)
+        {
+            _mm512_storeu_ps(values + i, _mm512_mul_ps(_mm512_loadu_ps(values + i), wide));
+        }
+    }
+
+    OVLLM_TARGET("avx2") static void scale_avx2(float *values, size_t size, size_t &i, float factor)
+    {
+        const __m256 wide = _mm256_set1_ps(factor);
+        for (; i + 8 <= size; i += 8)
+        {
+            _mm256_storeu_ps(values + i, _mm256_mul_ps(_mm256_loadu_ps(values + i), wide));
+        }
+    }
+
+    OVLLM_TARGET("avx2") static float sum_exp_avx2(const float *values, size_t size, size_t &i, float shift)
+    {
+        const __m256 offset = _mm256_set1_ps(shift);
+        __m256 wide = _mm256_setzero_ps();
+        for (; i + 8 <= size; i += 8)
+        {
+            wide = _mm256_add_ps(wide, exp256(_mm256_sub_ps(_mm256_loadu_ps(values + i), offset)));
+        }
+        return horizontal_sum(wide);
+    }
+
+    // Skips vectors with no value above threshold, stops at the first one with any or at end
+    OVLLM_TARGET("avx2") static void skip_below_avx2(const float *values, size_t end, size_t &i, float threshold)
+    {
+        const __m256 wide = _mm256_set1_ps(threshold);
+        for (; i + 8 <= end; i += 8)
+        {
+            if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(values + i), wide, _CMP_GT_OQ)) != 0)
+            {
+                return;
+            }
+        }
+    }
+
+    // Skips whole vectors whose mass does not reach target, taking it off target. last becomes the last
+    // token of positive weight skipped, banned and masked tokens weigh 0 and are never drawn.
+    OVLLM_TARGET("avx2") static void skip_mass_avx2(const float *values, size_t size, size_t &i, float shift, float &target,
+                                                    size_t &last)
+    {
+        const __m256 offset = _mm256_set1_ps(shift);
+        const __m256 zero = _mm256_setzero_ps();
+        for (; i + 8 <= size; i += 8)
+        {
+            const __m256 weights = exp256(_mm256_sub_ps(_mm256_loadu_ps(values + i), offset));
+            const float block = horizontal_sum(weights);
+            if (target - block <= 0.0f)
+            {
+                return;
+            }
+            target -= block;
+            const int positive = _mm256_movemask_ps(_mm256_cmp_ps(weights, zero, _CMP_GT_OQ));
+            for (int lane = 7; lane >= 0; --lane)
+            {
+                if ((positive >> lane) & 1)
+                {
+                    last = i + size_t(lane);
+                    break;
+                }
+            }
+        }
+    }
+#endif
+
+    float max_value(const float *values, size_t size)
+    {
+        float best = -std::numeric_limits<float>::infinity();
+        size_t i = 0;
+#if defined(OVLLM_X86)
+        if (cpu_features().avx512f)
+        {
+            best = max_value_avx512(values, size, i, best);
+        }
+        else if (cpu_features().avx2)
+        {
+            best = max_value_avx2(values, size, i, best);
+        }
+#endif
+        for (; i < size; ++i)
+        {
+            best = std::max(best, values[i]);
+        }
+        return best;
+    }
+
+    size_t argmax(const float *values, size_t size)
+    {
+        const float best = max_value(values, size);
+        size_t i = 0;
+#if defined(OVLLM_X86)
+        if (cpu_features().avx2 && find_avx2(values, size, i, best))
+        {
+            return i;
+        }
+#endif
+        for (; i < size; ++i)
+        {
+            if (values[i] == best)
+            {
+                return i;
+            }
+        }
+        return 0;
+    }
+
+    void scale(float *values, size_t size, float factor)
+    {
+        size_t i = 0;
+#if defined(OVLLM_X86)
+        if (cpu_features().avx512f)
+        {
+            scale_avx512(values, size, i, factor);
+        }
+        else if (cpu_features().avx2)
+        {
+            scale_avx2(values, size, i, factor);
+        }
+#endif
+        for (; i < size; ++i)
+        {
+            values[i] *= factor;
+        }
+    }
+
+    float sum_exp(const float *values, size_t size, float shift)
+    {
+        float sum = 0.0f;
+        size_t i = 0;
+#if defined(OVLLM_X86)
+        if (cpu_features().avx2)
+        {
+            sum = sum_exp_avx2(values, size, i, shift);
+        }
+#endif
+        for (; i < size; ++i)
+        {
+            sum += std::exp(values[i] - shift);
+        }
+        return sum;
+    }
+
+    Sampler::Sampler(const SamplerConfig &config, size_t vocab_size, uint64_t seed)
+        : m_config(config), m_vocab_size(vocab_size), m_generator(seed)
+    {
+        if (m_config.repetition_penalty != 1.0f)
+        {
+            m_seen.resize(vocab_size, false);
+        }
+    }
+
+    void Sampler::observe(int64_t token)
+    {
+        if (m_seen.empty() || token < 0 || size_t(token) >= m_vocab_size || m_seen[token])
+        {
+            return;
+        }
+        m_seen[token] = true;
+        m_penalized.push_back(static_cast<int32_t>(token));
+    }
+
+    void Sampler::select_top(const float *logits, size_t k)
+    {
+        m_candidates.clear();
+        if (k > kHeapSelection)
+        {
+            // Partial selection finds the k-th largest logit, a single pass then gathers the tokens above it
+            m_scratch.assign(logits, logits + m_vocab_size);
+            std::nth_element(m_scratch.begin(), m_scratch.begin() + (k - 1), m_scratch.end(), std::greater<float>());
+            const float threshold = m_scratch[k - 1];
+            for (size_t i = 0; i < m_vocab_size; ++i)
+            {
+                if (logits[i] > threshold)
+                {
+                    m_candidates.emplace_back(logits[i], static_cast<int32_t>(i));
+                }
+            }
+            for (size_t i = 0; i < m_vocab_size && m_candidates.size() < k; ++i)
+            {
+                if (logits[i] == threshold)
+                {
+                    m_candidates.emplace_back(logits[i], static_cast<int32_t>(i));
+                }
+            }
+        }
+        else
+        {
+            // Min-heap of the k best so far. Once it is full almost every logit falls below its
+            // minimum, and whole vectors of those are skipped with one comparison.
+            using Candidate = std::pair<float, int32_t>;
+            auto push = [this, k](float logit, size_t i)
+            {
+                if (m_candidates.size() == k)
+                {
+                    if (logit <= m_candidates.front().first)
+                    {
+                        return;
+                    }
+                    std::pop_heap(m_candidates.begin(), m_candidates.end(), std::greater<Candidate>());
+                    m_candidates.pop_back();
+                }
+                m_candidates.emplace_back(logit, static_cast<int32_t>(i));
+                std::push_heap(m_candidates.begin(), m_candidates.end(), std::greater<Candidate>());
+            };
+            size_t i = 0;
+#if defined(OVLLM_X86)
+            if (cpu_features().avx2)
+            {
+                const size_t vectors = m_vocab_size - m_vocab_size % 8;
+                while (i < vectors)
+                {
+                    if (m_candidates.size() == k)
+                    {
+                        skip_below_avx2(logits, vectors, i, m_candidates.front().first);
+                        if (i == vectors)
+                        {
+                            break;
+                        }
+                    }
+                    for (size_t j = i; j < i + 8; ++j)
+                    {
+                        push(logits[j], j);
+                    }
+                    i += 8;
+                }
+            }
+#endif
+            for (; i < m_vocab_size; ++i)
+            {
+                push(logits[i], i);
+            }
+        }
+        std::sort(m_candidates.begin(), m_candidates.end(), std::greater<std::pair<float, int32_t>>());
+    }
+
+    int64_t Sampler::sample(float *logits)
+    {
+        const size_t size = m_vocab_size;
+        const float penalty = m_config.repetition_penalty;
+        for (int32_t token : m_penalized)
+        {
+            logits[token] = logits[token] > 0.0f ? logits[token] / penalty : logits[token] * penalty;
+        }
+        if (!m_config.do_sample)
+        {
+            return argmax(logits, size);
+        }
+        if (m_config.temperature != 1.0f)
+        {
+            scale(logits, size, 1.0f / m_config.temperature);
+        }
+
+        const size_t top_k = m_config.top_k == 0 ? size : std::min(m_config.top_k, size);
+        const float top_p = m_config.top_p;
+        float shift = 0.0f;
+        float total = 0.0f;
+        if (top_k == size && top_p >= 1.0f)
+        {
+            // Plain multinomial, drawn with a running sum instead of a sort
+            shift = max_value(logits, size);
+            total = sum_exp(logits, size, shift);
+            float target = std::uniform_real_distribution<float>(0.0f, total)(m_generator);
+            size_t last = 0;
+            size_t i = 0;
+#if defined(OVLLM_X86)
+            if (cpu_features().avx2)
+            {
+                skip_mass_avx2(logits, size, i, shift, target, last);
+            }
+#endif
+            for (; i < size; ++i)
+            {
+                const float weight = std::exp(logits[i] - shift);
+                if (weight > 0.0f)
+                {
+                    last = i;
+                    target -= weight;
+                    if (target <= 0.0f)
+                    {
+                        return i;
+                    }
+                }
+            }
+            return last;
+        }
+
+        if (top_k < size)
+        {
+            select_top(logits, top_k);
+            shift = m_candidates.front().first;
+            for (const auto &candidate : m_candidates)
+            {
+                total += std::exp(candidate.first - shift);
+            }
+        }
+        else
+        {
+            // Top-p alone: probabilities are relative to the whole vocabulary
+            shift = max_value(logits, size);
+            total = sum_exp(logits, size, shift);
+            for (size_t take = kInitialTopP;; take *= 4)
+            {
+                select_top(logits, std::min(take, size));
+                float covered = 0.0f;
+                for (const auto &candidate : m_candidates)
+                {
+                    covered += std::exp(candidate.first - shift);
+                }
+                if (take >= size || covered >= top_p * total)
+                {
+                    break;
+                }
+            }
+        }
+
+        return draw_candidates(shift, total);
+    }
+
+    int64_t Sampler::sample_top(const float *values, const int32_t *ids, size_t k)
+    {
+        if (!m_config.do_sample)
+        {
+            return ids[0];
+        }
+        const size_t top_k = m_config.top_k == 0 ? k : std::min(m_config.top_k, k);
+        const float factor = 1.0f / m_config.temperature;
+        m_candidates.clear();
+        for (size_t i = 0; i < top_k; ++i)
+        {
+            m_candidates.emplace_back(values[i] * factor, ids[i]);
+        }
+        const float shift = m_candidates.front().first;
+        float total = 0.0f;
+        for (const auto &candidate : m_candidates)
+        {
+            total += std::exp(candidate.first - shift);
+        }
+        return draw_candidates(shift, total);
+    }
+
+    int64_t Sampler::draw_candidates(float shift, float total)
+    {
+        const float top_p = m_config.top_p;
+        // Smallest prefix of the sorted candidates holding top_p of the mass
+        float kept = 0.0f;
+        size_t count = 0;
+        while (count < m_candidates.size())
+        {
+            kept += std::exp(m_candidates[count++].first - shift);
+            if (kept >= top_p * total)
+            {
+                break;
+            }
+        }
+        float target = std::uniform_real_distribution<float>(0.0f, kept)(m_generator);
+        for (size_t i = 0; i < count; ++i)
+        {
+            target -= std::exp(m_candidates[i].first - shift);
+            if (target <= 0.0f)
+            {
+                return m_candidates[i].second;
+            }
+        }
+        return m_candidates[count - 1].second;
+    }
+}
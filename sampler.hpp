@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace ovllm
+{
+    struct SamplerConfig
+    {
+        bool do_sample = false;
+        float temperature = 1.0f;
+        // 0 keeps every token
+        size_t top_k = 0;
+        float top_p = 1.0f;
+        float repetition_penalty = 1.0f;
+    };
+
+    // Picks next tokens from a row of logits: repetition penalty, then argmax or temperature,
+    // top-k, top-p and a multinomial draw. Hot loops use AVX-512 or AVX2 when the CPU has them.
+    // One instance serves one request, its generator is seeded for reproducible draws.
+    class Sampler
+    {
+    public:
+        Sampler(const SamplerConfig &config, size_t vocab_size, uint64_t seed);
+
+        // Adds a prompt or generated token to the repetition penalty context.
+        void observe(int64_t token);
+        // Modifies logits in place.
+        int64_t sample(float *logits);
+        // Samples from the k best logits of a graph TopK, sorted descending, with their token ids.
+        // The caller ensures top_k fits in k, repetition penalty is not applied.
+        int64_t sample_top(const float *values, const int32_t *ids, size_t k);
+
+    private:
+        // Fills m_candidates with the k most likely tokens sorted by descending logit.
+        void select_top(const float *logits, size_t k);
+        // Draws from the smallest prefix of m_candidates holding top_p of total, weights are exp(logit - shift).
+        int64_t draw_candidates(float shift, float total);
+
+        SamplerConfig m_config;
+        size_t m_vocab_size;
+        std::mt19937_64 m_generator;
+        std::vector<int32_t> m_penalized;
+        std::vector<bool> m_seen;
+        std::vector<float> m_scratch;
+        std::vector<std::pair<float, int32_t>> m_candidates;
+    };
+
+    // Vectorized helpers, exposed for the sampler benchmark.
+    size_t argmax(const float *values, size_t size);
+    float max_value(const float *values, size_t size);
+    void scale(float *values, size_t size, float factor);
+    // Sum of exp(values[i] - shift).
+    float sum_exp(const float *values, size_t size, float shift);
+}
@@ -0,0 +1,455 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "metrics.hpp"
+#include "tracer.hpp"
+
+namespace ovllm
+{
+    Scheduler::Scheduler(BackendEngine &engine, const SchedulerConfig &config)
+        : m_engine(engine), m_config(config), m_snapshot_bytes_per_token(engine.kv_bytes_per_token())
+    {
+        if (m_config.max_sessions == 0)
+        {
+            throw std::invalid_argument("Scheduler needs at least one session");
+        }
+        if (m_config.kv_cache_budget != 0 && m_engine.kv_bytes_per_token() == 0)
+        {
+            throw std::invalid_argument("A KV cache budget needs a model whose KV cache size per token is known");
+        }
+        for (auto &[id, tenant] : m_config.tenants)
+        {
+            if (!(tenant.weight > 0.0) || tenant.tokens_per_second < 0.0)
+            {
+                throw std::invalid_argument("Tenant '" + id + "' needs a positive weight and a non-negative token rate");
+            }
+            tenant.burst = std::max(tenant.burst, tenant.tokens_per_second);
+        }
+        m_worker = std::thread(&Scheduler::run, this);
+    }
+
+    Scheduler::~Scheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_one();
+        m_worker.join();
+    }
+
+    static std::string mebibytes(size_t bytes)
+    {
+        return std::to_string((bytes + (1 << 20) - 1) >> 20) + " MiB";
+    }
+
+    void Scheduler::submit(Request request, Completion completion)
+    {
+        const size_t positions = request.prompt.size() + request.config.get_max_new_tokens(request.prompt.size());
+        const size_t kv_bytes = positions * m_engine.kv_bytes_per_token();
+        if (m_config.kv_cache_budget != 0 && kv_bytes > m_config.kv_cache_budget)
+        {
+            metrics().rejected_requests.fetch_add(1, std::memory_order_relaxed);
+            throw std::length_error("Request needs up to " + mebibytes(kv_bytes) + " of KV cache for " + std::to_string(positions) +
+                                    " positions, more than the budget of " + mebibytes(m_config.kv_cache_budget) +
+                                    ". Shorten the prompt or lower maxNewTokens");
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping)
+            {
+                throw std::runtime_error("Scheduler is stopping");
+            }
+            if (m_config.max_queued != 0 && m_queued >= m_config.max_queued)
+            {
+                metrics().rejected_requests.fetch_add(1, std::memory_order_relaxed);
+                throw std::runtime_error("Server is busy: " + std::to_string(m_queued) + " requests are waiting, try again later");
+            }
+            auto found = m_tenants.find(request.tenant);
+            if (found == m_tenants.end())
+            {
+                Tenant tenant;
+                auto config = m_config.tenants.find(request.tenant);
+                if (config != m_config.tenants.end())
+                {
+                    tenant.config = config->second;
+                }
+                tenant.tokens = tenant.config.burst;
+                tenant.refilled = std::chrono::steady_clock::now();
+                tenant.metrics = &metrics().tenant(request.tenant.empty() ? "default" : request.tenant);
+                found = m_tenants.emplace(request.tenant, std::move(tenant)).first;
+            }
+            Tenant &tenant = found->second;
+            Job job;
+            job.request = std::move(request);
+            job.completion = std::move(completion);
+            job.kv_bytes = kv_bytes;
+            job.tenant = &tenant;
+            job.priority = job.request.priority;
+            job.prompt_tokens = job.request.prompt.size();
+            // A tenant returning from idle starts at the current virtual time, it banks no share
+            job.start = std::max(m_virtual_time, tenant.finish);
+            tenant.finish = job.start + double(positions) / tenant.config.weight;
+            tenant.waiting.push_back(std::move(job));
+            ++m_queued;
+        }
+        metrics().queued_requests.fetch_add(1, std::memory_order_relaxed);
+        m_wake.notify_one();
+    }
+
+    BackendSession *Scheduler::acquire_session()
+    {
+        if (m_free_sessions.empty())
+        {
+            // Sessions are created on first use, each InferRequest holds its own KV cache
+            m_sessions.push_back(m_engine.create_session());
+            return m_sessions.back().get();
+        }
+        BackendSession *session = m_free_sessions.back();
+        m_free_sessions.pop_back();
+        return session;
+    }
+
+    Scheduler::Admission Scheduler::admit(std::vector<Job> &active)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        Admission admission;
+        for (auto &[id, tenant] : m_tenants)
+        {
+            if (tenant.config.tokens_per_second > 0.0)
+            {
+                const double elapsed = std::chrono::duration<double>(now - tenant.refilled).count();
+                tenant.tokens = std::min(tenant.config.burst, tenant.tokens + elapsed * tenant.config.tokens_per_second);
+                tenant.refilled = now;
+            }
+        }
+        for (;;)
+        {
+            std::deque<Job> *queue = nullptr;
+            std::deque<Job>::iterator next;
+            auto consider = [&](std::deque<Job> &jobs, std::deque<Job>::iterator job)
+            {
+                if (queue == nullptr || job->priority > next->priority || (job->priority == next->priority && job->start < next->start))
+                {
+                    queue = &jobs;
+                    next = job;
+                }
+            };
+            // Suspended jobs were admitted before, rate limits do not hold them back
+            for (auto job = m_preempted.begin(); job != m_preempted.end(); ++job)
+            {
+                consider(m_preempted, job);
+            }
+            for (auto &[id, tenant] : m_tenants)
+            {
+                if (tenant.waiting.empty())
+                {
+                    continue;
+                }
+                if (tenant.config.tokens_per_second > 0.0 && tenant.tokens <= 0.0)
+                {
+                    const auto refilled = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                    std::chrono::duration<double>((1.0 - tenant.tokens) / tenant.config.tokens_per_second));
+                    admission.retry = admission.retry ? std::min(*admission.retry, refilled) : refilled;
+                    continue;
+                }
+                // The tenant's first request of its highest priority
+                auto best = tenant.waiting.begin();
+                for (auto job = best; job != tenant.waiting.end(); ++job)
+                {
+                    if (job->priority > best->priority)
+                    {
+                        best = job;
+                    }
+                }
+                consider(tenant.waiting, best);
+            }
+            if (queue == nullptr)
+            {
+                break;
+            }
+            // A suspended job's snapshot is charged already, its reservation replaces it
+            const size_t held = queue == &m_preempted ? next->snapshot_bytes : 0;
+            // The best candidate that does not fit yet holds back the others, which keeps long requests
+            // from starving
+            if (active.size() >= m_config.max_sessions ||
+                (m_config.kv_cache_budget != 0 && m_kv_reserved + next->kv_bytes > m_config.kv_cache_budget + held))
+            {
+                admission.blocked = true;
+                admission.blocked_priority = next->priority;
+                admission.blocked_kv_bytes = next->kv_bytes - std::min(held, next->kv_bytes);
+                break;
+            }
+            Job &job = *next;
+            if (queue != &m_preempted)
+            {
+                if (trace::enabled())
+                {
+                    trace::record("queued", job.submitted, trace::Clock::now(), job.request.id);
+                }
+                m_virtual_time = job.start;
+                if (job.tenant->config.tokens_per_second > 0.0)
+                {
+                    job.tenant->tokens -= double(job.request.prompt.size());
+                }
+                job.tenant->metrics->requests.fetch_add(1, std::memory_order_relaxed);
+                job.tenant->metrics->prompt_tokens.fetch_add(job.request.prompt.size(), std::memory_order_relaxed);
+                job.tenant->metrics->queue_wait.observe(std::chrono::duration<double>(now - job.submitted).count());
+                --m_queued;
+                metrics().queued_requests.fetch_sub(1, std::memory_order_relaxed);
+            }
+            m_kv_reserved = m_kv_reserved + job.kv_bytes - held;
+            metrics().kv_cache_reserved_bytes.fetch_add(int64_t(job.kv_bytes) - int64_t(held), std::memory_order_relaxed);
+            active.push_back(std::move(job));
+            queue->erase(next);
+        }
+        return admission;
+    }
+
+    // KV cache a job keeps charged to the budget once suspended: its snapshot, estimated from the positions
+    // it holds until it is taken
+    size_t Scheduler::snapshot_estimate(const Job &job) const
+    {
+        if (!job.generation)
+        {
+            return 0;
+        }
+        if (job.generation->suspended())
+        {
+            return job.snapshot_bytes;
+        }
+        return (job.prompt_tokens + job.generation->result().stats.generated_tokens) * m_snapshot_bytes_per_token;
+    }
+
+    bool Scheduler::preempt(std::vector<Job> &active, const Admission &admission)
+    {
+        // The lowest priority, and the latest admitted of those: it has the least progress to set aside
+        auto victim = active.end();
+        size_t reclaimable = 0;
+        for (auto job = active.begin(); job != active.end(); ++job)
+        {
+            if (job->priority >= admission.blocked_priority)
+            {
+                continue;
+            }
+            // Snapshots stay in memory, only the rest of a reservation is freed
+            reclaimable += job->kv_bytes - std::min(snapshot_estimate(*job), job->kv_bytes);
+            if (victim == active.end() || job->priority <= victim->priority)
+            {
+                victim = job;
+            }
+        }
+        auto fits = [&]
+        {
+            return m_config.kv_cache_budget == 0 ||
+                   m_kv_reserved - reclaimable + admission.blocked_kv_bytes <= m_config.kv_cache_budget;
+        };
+        if (victim == active.end() || !fits())
+        {
+            return false;
+        }
+        // A job admitted back but not yet resumed still holds its snapshot
+        if (victim->generation && !victim->generation->suspended())
+        {
+            const size_t estimate = snapshot_estimate(*victim);
+            const size_t positions = victim->prompt_tokens + victim->generation->result().stats.generated_tokens;
+            try
+            {
+                victim->snapshot_bytes = victim->generation->suspend();
+            }
+            catch (...)
+            {
+                complete(*victim, std::current_exception());
+                active.erase(victim);
+                return true;
+            }
+            if (positions != 0)
+            {
+                m_snapshot_bytes_per_token = std::max(m_snapshot_bytes_per_token, (victim->snapshot_bytes + positions - 1) / positions);
+            }
+            // The snapshot can outgrow its estimate. When the candidate no longer fits, the victim carries on.
+            reclaimable = reclaimable - (victim->kv_bytes - std::min(estimate, victim->kv_bytes)) +
+                          (victim->kv_bytes - std::min(victim->snapshot_bytes, victim->kv_bytes));
+            if (!fits())
+            {
+                try
+                {
+                    victim->generation->resume(*victim->session);
+                    victim->snapshot_bytes = 0;
+                }
+                catch (...)
+                {
+                    complete(*victim, std::current_exception());
+                    active.erase(victim);
+                    return true;
+                }
+                return false;
+            }
+            metrics().preemptions.fetch_add(1, std::memory_order_relaxed);
+            metrics().preempted_kv_bytes.fetch_add(int64_t(victim->snapshot_bytes), std::memory_order_relaxed);
+            m_free_sessions.push_back(victim->session);
+            victim->session = nullptr;
+        }
+        // The reservation gives way to the snapshot, which stays charged until the job is admitted again
+        m_kv_reserved = m_kv_reserved - victim->kv_bytes + victim->snapshot_bytes;
+        metrics().kv_cache_reserved_bytes.fetch_add(int64_t(victim->snapshot_bytes) - int64_t(victim->kv_bytes), std::memory_order_relaxed);
+        m_preempted.push_back(std::move(*victim));
+        active.erase(victim);
+        return true;
+    }
+
+    bool Scheduler::resume_preempted(std::vector<Job> &active)
+    {
+        if (m_preempted.empty())
+        {
+            return false;
+        }
+        // The earliest preempted of the lowest priority, the candidates it holds back may preempt it again
+        auto job = m_preempted.begin();
+        for (auto other = job; other != m_preempted.end(); ++other)
+        {
+            if (other->priority < job->priority)
+            {
+                job = other;
+            }
+        }
+        m_kv_reserved = m_kv_reserved + job->kv_bytes - job->snapshot_bytes;
+        metrics().kv_cache_reserved_bytes.fetch_add(int64_t(job->kv_bytes) - int64_t(job->snapshot_bytes), std::memory_order_relaxed);
+        active.push_back(std::move(*job));
+        m_preempted.erase(job);
+        return true;
+    }
+
+    void Scheduler::complete(Job &job, std::exception_ptr error)
+    {
+        job.completion(error ? Result() : std::move(job.generation->result()), error);
+        if (job.session != nullptr)
+        {
+            m_free_sessions.push_back(job.session);
+        }
+        m_kv_reserved -= job.kv_bytes;
+        metrics().kv_cache_reserved_bytes.fetch_sub(int64_t(job.kv_bytes), std::memory_order_relaxed);
+    }
+
+    void Scheduler::charge(Job &job)
+    {
+        const size_t generated = job.generation->result().stats.generated_tokens;
+        if (generated == job.charged)
+        {
+            return;
+        }
+        if (job.tenant->config.tokens_per_second > 0.0)
+        {
+            job.tenant->tokens -= double(generated - job.charged);
+        }
+        job.tenant->metrics->generated_tokens.fetch_add(generated - job.charged, std::memory_order_relaxed);
+        job.charged = generated;
+    }
+
+    void Scheduler::run()
+    {
+        trace::name_thread("scheduler");
+        std::vector<Job> active;
+        for (;;)
+        {
+            Admission admission;
+            bool stalled = false;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                while (!m_stopping)
+                {
+                    admission = admit(active);
+                    // With nothing running, only snapshots charged to the budget can hold back the best
+                    // candidate, and nothing else would free them. The resumed job may go past the budget
+                    // by the rest of its reservation, its snapshot is in memory already.
+                    if (active.empty() && admission.blocked)
+                    {
+                        stalled = resume_preempted(active);
+                    }
+                    if (!active.empty())
+                    {
+                        break;
+                    }
+                    if (admission.retry)
+                    {
+                        m_wake.wait_until(lock, *admission.retry);
+                    }
+                    else
+                    {
+                        m_wake.wait(lock);
+                    }
+                }
+                if (m_stopping)
+                {
+                    break;
+                }
+            }
+            // Between steps, a blocked request of higher priority takes the place of a running one. A job
+            // resumed for a stall takes a step first.
+            if (admission.blocked && !stalled && preempt(active, admission))
+            {
+                continue;
+            }
+
+            // One forward pass per generation and round
+            for (auto job = active.begin(); job != active.end();)
+            {
+                bool running = false;
+                std::exception_ptr error;
+                try
+                {
+                    if (!job->generation)
+                    {
+                        job->session = acquire_session();
+                        job->generation = std::make_unique<BackendGeneration>(m_engine, *job->session, std::move(job->request));
+                    }
+                    else if (job->generation->suspended())
+                    {
+                        job->session = acquire_session();
+                        metrics().preempted_kv_bytes.fetch_sub(int64_t(job->snapshot_bytes), std::memory_order_relaxed);
+                        job->snapshot_bytes = 0;
+                        job->generation->resume(*job->session);
+                    }
+                    running = job->generation->step();
+                    charge(*job);
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+                if (running)
+                {
+                    ++job;
+                    continue;
+                }
+                complete(*job, error);
+                job = active.erase(job);
+            }
+        }
+
+        const auto stopped = std::make_exception_ptr(std::runtime_error("Scheduler was stopped"));
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (Job &job : active)
+        {
+            job.completion(Result(), stopped);
+            metrics().kv_cache_reserved_bytes.fetch_sub(int64_t(job.kv_bytes), std::memory_order_relaxed);
+        }
+        for (Job &job : m_preempted)
+        {
+            job.completion(Result(), stopped);
+            metrics().preempted_kv_bytes.fetch_sub(int64_t(job.snapshot_bytes), std::memory_order_relaxed);
+            metrics().kv_cache_reserved_bytes.fetch_sub(int64_t(job.snapshot_bytes), std::memory_order_relaxed);
+        }
+        for (auto &[id, tenant] : m_tenants)
+        {
+            for (Job &job : tenant.waiting)
+            {
+                job.completion(Result(), stopped);
+                metrics().queued_requests.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+    }
+}
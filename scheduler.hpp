@@ -0,0 +1,156 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "backend.hpp"
+#include "metrics.hpp"
+
+namespace ovllm
+{
+    // Share and rate limit of one tenant's requests.
+    struct TenantConfig
+    {
+        // Share of admissions relative to the other tenants with waiting requests
+        double weight = 1.0;
+        // Prompt plus generated tokens per second refilled into the tenant's bucket, 0 is unlimited
+        double tokens_per_second = 0.0;
+        // Bucket size, the tokens an idle tenant can spend at once. At least one second of refill.
+        double burst = 0.0;
+    };
+
+    struct SchedulerConfig
+    {
+        // Generations decoded concurrently, each on its own session and KV cache
+        size_t max_sessions = 4;
+        // Bytes of KV cache the running generations may grow to. A request is admitted once the
+        // projected peak of its cache, prompt plus max_new_tokens positions, fits next to those of the
+        // running ones. 0 admits on free sessions alone.
+        size_t kv_cache_budget = 0;
+        // Requests waiting for admission before submit rejects new ones, 0 is unbounded
+        size_t max_queued = 0;
+        // By Request::tenant, tenants without an entry get a weight of 1 and no rate limit
+        std::map<std::string, TenantConfig> tenants;
+    };
+
+    // Runs submitted requests on a worker thread, one forward pass per active generation in turn.
+    // A long prompt advances by one prefill chunk between the decode steps of the other streams,
+    // which bounds their inter-token latency by the chunk size instead of the prompt length.
+    // Waiting requests are admitted by priority, then by start-time fair queuing across tenants, in
+    // proportion to their weights and in order of arrival within a tenant. A tenant over its token
+    // rate waits until its bucket refills, running generations are never paused for it.
+    // A request that finds no session or KV budget left preempts a running generation of lower
+    // priority: at a step boundary its KV cache is copied out and its session freed. It resumes from
+    // the snapshot, without a new prefill, once it is the best candidate again. The snapshot stays
+    // charged to the KV cache budget in place of the generation's reservation until then. When nothing
+    // runs and snapshots alone hold back the best candidate, the lowest priority suspended job resumes.
+    class Scheduler
+    {
+    public:
+        // Called on the worker thread with the result, or with the exception the request failed with.
+        using Completion = std::function<void(Result &&result, std::exception_ptr error)>;
+
+        Scheduler(BackendEngine &engine, const SchedulerConfig &config);
+        // Fails pending and running requests, then joins the worker.
+        ~Scheduler();
+
+        // request.on_token is called on the worker thread. Throws right away for a request whose KV
+        // cache could never fit the budget, or when the queue is full.
+        void submit(Request request, Completion completion);
+
+    private:
+        struct Tenant;
+
+        struct Job
+        {
+            Request request;
+            Completion completion;
+            std::chrono::steady_clock::time_point submitted = std::chrono::steady_clock::now();
+            // Projected peak KV cache, reserved from admission to completion
+            size_t kv_bytes = 0;
+            Tenant *tenant = nullptr;
+            // Request::priority and the prompt length, kept once the request moves into the generation
+            int priority = 0;
+            size_t prompt_tokens = 0;
+            // Virtual start time, the tenant's previous requests take up cost over weight before it
+            double start = 0.0;
+            // Generated tokens taken from the tenant's bucket so far
+            size_t charged = 0;
+            BackendSession *session = nullptr;
+            std::unique_ptr<BackendGeneration> generation;
+            // KV cache snapshot held while suspended, charged to the budget until the job is admitted again
+            size_t snapshot_bytes = 0;
+        };
+
+        struct Tenant
+        {
+            TenantConfig config;
+            std::deque<Job> waiting;
+            // Virtual finish time of the tenant's last submitted request
+            double finish = 0.0;
+            // Bucket balance, negative while generations run past it. Worker thread only.
+            double tokens = 0.0;
+            std::chrono::steady_clock::time_point refilled;
+            TenantMetrics *metrics = nullptr;
+        };
+
+        struct Admission
+        {
+            // When a rate limited tenant can be admitted next
+            std::optional<std::chrono::steady_clock::time_point> retry;
+            // The next candidate found no session or KV budget left
+            bool blocked = false;
+            int blocked_priority = 0;
+            size_t blocked_kv_bytes = 0;
+        };
+
+        void run();
+        // Moves waiting and suspended jobs to active while sessions and the KV budget allow, by
+        // priority and then virtual start time.
+        Admission admit(std::vector<Job> &active);
+        // Suspends a running job of lower priority than the blocked candidate. Returns false when none
+        // is running, or suspending all of them would not make room.
+        bool preempt(std::vector<Job> &active, const Admission &admission);
+        // Moves the lowest priority suspended job to active, whether or not the budget allows. Returns
+        // false when none is suspended.
+        bool resume_preempted(std::vector<Job> &active);
+        size_t snapshot_estimate(const Job &job) const;
+        // Takes the tokens generated since the last call from the job's tenant bucket.
+        void charge(Job &job);
+        // Calls the completion, then releases the session and KV reservation.
+        void complete(Job &job, std::exception_ptr error);
+        BackendSession *acquire_session();
+
+        BackendEngine &m_engine;
+        SchedulerConfig m_config;
+        std::vector<std::unique_ptr<BackendSession>> m_sessions;
+        std::vector<BackendSession *> m_free_sessions;
+
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        // By tenant id, nodes are never removed so jobs keep pointers to them
+        std::map<std::string, Tenant> m_tenants;
+        size_t m_queued = 0;
+        // Start time of the last admitted job
+        double m_virtual_time = 0.0;
+        // KV cache reserved by admitted jobs, worker thread only
+        size_t m_kv_reserved = 0;
+        // Largest snapshot size per position seen, snapshots keep the precision the model's variables
+        // declare rather than the compiled KV cache precision. Worker thread only.
+        size_t m_snapshot_bytes_per_token = 0;
+        // Jobs taken off their session for higher priority ones, in preemption order. Worker thread only.
+        std::deque<Job> m_preempted;
+        bool m_stopping = false;
+        std::thread m_worker;
+    };
+}
@@ -0,0 +1,71 @@
+#include "stop_matcher.hpp"
+
+#include <algorithm>
+#include <queue>
+
+namespace ovllm
+{
+    StopMatcher::StopMatcher(const std::vector<std::string> &stops) : m_nodes(1)
+    {
+        // Trie, with 0 standing for a missing edge since the root is never a child
+        for (const std::string &stop : stops)
+        {
+            uint32_t node = 0;
+            for (unsigned char byte : stop)
+            {
+                if (m_nodes[node].next[byte] == 0)
+                {
+                    m_nodes[node].next[byte] = static_cast<uint32_t>(m_nodes.size());
+                    Node child;
+                    child.depth = m_nodes[node].depth + 1;
+                    m_nodes.push_back(child);
+                }
+                node = m_nodes[node].next[byte];
+            }
+            m_nodes[node].match_length = std::max<uint32_t>(m_nodes[node].match_length, static_cast<uint32_t>(stop.size()));
+        }
+
+        // Breadth-first pass turning the trie into a full transition table via failure links
+        std::queue<uint32_t> queue;
+        for (uint32_t &child : m_nodes[0].next)
+        {
+            if (child != 0)
+            {
+                queue.push(child);
+            }
+        }
+        while (!queue.empty())
+        {
+            const uint32_t node = queue.front();
+            queue.pop();
+            const uint32_t fail = m_nodes[node].fail;
+            m_nodes[node].match_length = std::max(m_nodes[node].match_length, m_nodes[fail].match_length);
+            for (size_t byte = 0; byte < 256; ++byte)
+            {
+                uint32_t &child = m_nodes[node].next[byte];
+                if (child != 0)
+                {
+                    m_nodes[child].fail = m_nodes[fail].next[byte];
+                    queue.push(child);
+                }
+                else
+                {
+                    child = m_nodes[fail].next[byte];
+                }
+            }
+        }
+    }
+
+    size_t StopMatcher::feed(const std::string &chunk)
+    {
+        for (size_t i = 0; i < chunk.size(); ++i)
+        {
+            m_state = m_nodes[m_state].next[static_cast<unsigned char>(chunk[i])];
+            if (m_nodes[m_state].match_length != 0)
+            {
+                return i + 1;
+            }
+        }
+        return npos;
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace ovllm
+{
+    // Aho-Corasick automaton over a set of stop strings, fed incrementally one chunk at a time.
+    // Transitions are precomputed for every byte, so matching costs O(1) per input byte
+    // regardless of how many stop strings there are.
+    class StopMatcher
+    {
+    public:
+        static constexpr size_t npos = std::string::npos;
+
+        explicit StopMatcher(const std::vector<std::string> &stops);
+
+        // Feeds chunk and returns the number of its bytes up to and including the end of the first
+        // stop string found, or npos. match_length() is the length of that stop string.
+        size_t feed(const std::string &chunk);
+        size_t match_length() const { return m_nodes[m_state].match_length; }
+        // Length of the longest suffix of the text fed so far that may still grow into a stop string.
+        size_t pending() const { return m_nodes[m_state].depth; }
+        bool empty() const { return m_nodes.size() == 1; }
+        void reset() { m_state = 0; }
+
+    private:
+        struct Node
+        {
+            std::array<uint32_t, 256> next{};
+            uint32_t fail = 0;
+            uint32_t depth = 0;
+            // Longest stop string ending at this node, 0 when none does
+            uint32_t match_length = 0;
+        };
+
+        std::vector<Node> m_nodes;
+        uint32_t m_state = 0;
+    };
+}
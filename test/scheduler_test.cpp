@@ -0,0 +1,202 @@
+// Checks preemption under a KV cache budget on the mock backend, runs without a model. Requests are
+// submitted from token callbacks so that every run takes the same scheduling path.
+// Usage: scheduler_test
+// Built with OVLLM_MOCK_BACKEND, the scheduler drives MockEngine.
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef OVLLM_MOCK_BACKEND
+#error "scheduler_test drives the mock backend, build it with OVLLM_MOCK_BACKEND defined"
+#endif
+
+#include "../metrics.hpp"
+#include "../scheduler.hpp"
+
+struct Submitted
+{
+    explicit Submitted(std::string name) : name(std::move(name)) {}
+
+    std::string name;
+    size_t max_new_tokens = 0;
+    std::promise<ovllm::Result> promise;
+    std::future<ovllm::Result> result = promise.get_future();
+};
+
+static ovllm::Request make_request(size_t prompt_tokens, size_t max_new_tokens, int priority)
+{
+    ovllm::Request request;
+    request.prompt.assign(prompt_tokens, 1);
+    request.config.max_new_tokens = max_new_tokens;
+    request.config.ignore_eos = true;
+    request.priority = priority;
+    return request;
+}
+
+static void submit(ovllm::Scheduler &scheduler, ovllm::Request request, Submitted &submitted)
+{
+    submitted.max_new_tokens = request.config.max_new_tokens;
+    scheduler.submit(std::move(request),
+                     [&submitted](ovllm::Result &&result, std::exception_ptr error)
+                     {
+                         if (error)
+                         {
+                             submitted.promise.set_exception(error);
+                         }
+                         else
+                         {
+                             submitted.promise.set_value(std::move(result));
+                         }
+                     });
+}
+
+// Waits for every request, a scheduler that stalls leaves them pending
+static int check_results(const char *test, std::vector<Submitted *> requests)
+{
+    int failures = 0;
+    for (Submitted *submitted : requests)
+    {
+        if (submitted->result.wait_for(std::chrono::seconds(10)) != std::future_status::ready)
+        {
+            std::fprintf(stderr, "%s: %s did not finish, the scheduler stalled\n", test, submitted->name.c_str());
+            ++failures;
+            continue;
+        }
+        try
+        {
+            const ovllm::Result result = submitted->result.get();
+            if (result.tokens.size() != submitted->max_new_tokens)
+            {
+                std::fprintf(stderr, "%s: %s generated %zu tokens, expected %zu\n", test, submitted->name.c_str(),
+                             result.tokens.size(), submitted->max_new_tokens);
+                ++failures;
+            }
+        }
+        catch (const std::exception &error)
+        {
+            std::fprintf(stderr, "%s: %s failed: %s\n", test, submitted->name.c_str(), error.what());
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+// One session and a budget of 100 bytes at 1 byte per position. L (priority 0) is preempted for H
+// (priority 1), H2 (priority 2) arrives during H but cannot preempt it, and once H finishes H2 still
+// does not fit next to L's snapshot. The worker must resume L rather than wait for a request.
+static int check_stall(ovllm::MockOptions options)
+{
+    options.kv_bytes_per_token = 1;
+    ovllm::MockEngine engine(options);
+    ovllm::SchedulerConfig config;
+    config.max_sessions = 1;
+    config.kv_cache_budget = 100;
+
+    Submitted low("L"), high("H"), highest("H2");
+    const uint64_t preemptions = ovllm::metrics().preemptions.load();
+    int failures = 0;
+    {
+        ovllm::Scheduler scheduler(engine, config);
+        ovllm::Request request = make_request(10, 80, 0);
+        size_t generated = 0;
+        request.on_token = [&](int64_t)
+        {
+            if (++generated == 5)
+            {
+                ovllm::Request next = make_request(10, 20, 1);
+                next.on_token = [&, started = false](int64_t) mutable
+                {
+                    if (!started)
+                    {
+                        started = true;
+                        submit(scheduler, make_request(10, 85, 2), highest);
+                    }
+                    return false;
+                };
+                submit(scheduler, std::move(next), high);
+            }
+            return false;
+        };
+        submit(scheduler, std::move(request), low);
+        failures += check_results("stall", {&low, &high, &highest});
+    }
+    if (ovllm::metrics().preemptions.load() - preemptions != 1)
+    {
+        std::fprintf(stderr, "stall: %lld preemptions, expected 1\n",
+                     static_cast<long long>(ovllm::metrics().preemptions.load() - preemptions));
+        ++failures;
+    }
+    if (failures == 0)
+    {
+        std::printf("scheduler_test: stall passed\n");
+    }
+    return failures;
+}
+
+// Snapshots take 4 bytes per position against a KV cache of 1, as f32 copies of an u8 cache would.
+// Preempting L for H looks like it frees room by the per-token estimate, but L's snapshot alone is
+// larger than the budget, so the preemption has to be undone and H waits for L to finish.
+static int check_snapshot_size(ovllm::MockOptions options)
+{
+    options.kv_bytes_per_token = 1;
+    options.snapshot_bytes_per_token = 4;
+    ovllm::MockEngine engine(options);
+    ovllm::SchedulerConfig config;
+    config.max_sessions = 1;
+    config.kv_cache_budget = 100;
+
+    Submitted low("L"), high("H");
+    const uint64_t preemptions = ovllm::metrics().preemptions.load();
+    int failures = 0;
+    {
+        ovllm::Scheduler scheduler(engine, config);
+        ovllm::Request request = make_request(40, 50, 0);
+        size_t generated = 0;
+        request.on_token = [&](int64_t)
+        {
+            if (++generated == 10)
+            {
+                submit(scheduler, make_request(10, 20, 1), high);
+            }
+            return false;
+        };
+        submit(scheduler, std::move(request), low);
+        failures += check_results("snapshot size", {&low, &high});
+    }
+    if (ovllm::metrics().preemptions.load() != preemptions)
+    {
+        std::fprintf(stderr, "snapshot size: %lld preemptions, expected none\n",
+                     static_cast<long long>(ovllm::metrics().preemptions.load() - preemptions));
+        ++failures;
+    }
+    if (ovllm::metrics().kv_cache_reserved_bytes.load() != 0)
+    {
+        std::fprintf(stderr, "snapshot size: %lld bytes of KV cache still reserved\n",
+                     static_cast<long long>(ovllm::metrics().kv_cache_reserved_bytes.load()));
+        ++failures;
+    }
+    if (failures == 0)
+    {
+        std::printf("scheduler_test: snapshot size passed\n");
+    }
+    return failures;
+}
+
+int main()
+{
+    ovllm::MockOptions options;
+    options.prefill_latency = std::chrono::microseconds(100);
+    options.tokens_per_second = 10000.0;
+    const int failures = check_stall(options) + check_snapshot_size(options);
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "scheduler_test: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,218 @@
+// Checks the inputs a Session binds across a multi-step decode, and what trim() keeps of the KV cache, on
+// tiny models built in place, no model directory needed. The models' logits are
+// input_ids * sum(attention_mask), so a mask element that is not 1 shows in the output as well as in the
+// bound tensor.
+// Usage: session_test
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "openvino/op/assign.hpp"
+#include "openvino/op/concat.hpp"
+#include "openvino/op/constant.hpp"
+#include "openvino/op/convert.hpp"
+#include "openvino/op/gather.hpp"
+#include "openvino/op/multiply.hpp"
+#include "openvino/op/parameter.hpp"
+#include "openvino/op/read_value.hpp"
+#include "openvino/op/reduce_sum.hpp"
+#include "openvino/op/result.hpp"
+#include "openvino/op/transpose.hpp"
+#include "openvino/op/unsqueeze.hpp"
+#include "../arena.hpp"
+#include "../engine.hpp"
+
+struct Inputs
+{
+    std::shared_ptr<ov::op::v0::Parameter> input_ids;
+    std::shared_ptr<ov::op::v0::Parameter> attention_mask;
+    std::shared_ptr<ov::Node> logits;
+};
+
+static Inputs mask_sum_inputs()
+{
+    Inputs inputs;
+    inputs.input_ids = std::make_shared<ov::op::v0::Parameter>(ov::element::i64, ov::PartialShape{1, -1});
+    inputs.input_ids->output(0).set_names({"input_ids"});
+    inputs.attention_mask = std::make_shared<ov::op::v0::Parameter>(ov::element::i64, ov::PartialShape{1, -1});
+    inputs.attention_mask->output(0).set_names({"attention_mask"});
+
+    auto axis = ov::op::v0::Constant::create(ov::element::i64, {1}, {1});
+    auto length = std::make_shared<ov::op::v1::ReduceSum>(inputs.attention_mask, axis, true);
+    auto product = std::make_shared<ov::op::v1::Multiply>(std::make_shared<ov::op::v0::Convert>(inputs.input_ids, ov::element::f32),
+                                                          std::make_shared<ov::op::v0::Convert>(length, ov::element::f32));
+    inputs.logits = std::make_shared<ov::op::v0::Unsqueeze>(product, ov::op::v0::Constant::create(ov::element::i64, {1}, {2}));
+    inputs.logits->output(0).set_names({"logits"});
+    return inputs;
+}
+
+static std::shared_ptr<ov::Model> mask_sum_model()
+{
+    Inputs inputs = mask_sum_inputs();
+    return std::make_shared<ov::Model>(ov::OutputVector{inputs.logits}, ov::ParameterVector{inputs.input_ids, inputs.attention_mask});
+}
+
+// Two KV caches holding the input ids of every step, one laid out [batch, heads, sequence, 1] like most
+// models and one [sequence, batch, heads, 1] like ChatGLM, each reordered by beam_idx on its batch axis
+static std::shared_ptr<ov::Model> kv_cache_model()
+{
+    Inputs inputs = mask_sum_inputs();
+    auto beam_idx = std::make_shared<ov::op::v0::Parameter>(ov::element::i32, ov::PartialShape{-1});
+    beam_idx->output(0).set_names({"beam_idx"});
+    auto ids = std::make_shared<ov::op::v0::Convert>(inputs.input_ids, ov::element::f32);
+
+    auto cache = [&](const char *id, const ov::PartialShape &shape, const ov::Shape &empty, int64_t batch_axis,
+                     int64_t sequence_axis, const ov::Output<ov::Node> &values)
+    {
+        auto variable = std::make_shared<ov::op::util::Variable>(ov::op::util::VariableInfo{shape, ov::element::f32, id});
+        auto init = ov::op::v0::Constant::create(ov::element::f32, empty, std::vector<float>{});
+        auto read = std::make_shared<ov::op::v6::ReadValue>(init, variable);
+        auto reordered = std::make_shared<ov::op::v8::Gather>(read, beam_idx,
+                                                             ov::op::v0::Constant::create(ov::element::i64, {}, {batch_axis}));
+        auto concat = std::make_shared<ov::op::v0::Concat>(ov::OutputVector{reordered, values}, sequence_axis);
+        return std::make_shared<ov::op::v6::Assign>(concat, variable);
+    };
+
+    // [1, S] ids to [1, 2, S, 1]
+    auto heads_first = std::make_shared<ov::op::v0::Unsqueeze>(ids, ov::op::v0::Constant::create(ov::element::i64, {2}, {1, 3}));
+    auto batch_first = std::make_shared<ov::op::v0::Concat>(ov::OutputVector{heads_first, heads_first}, 1);
+    // [1, S] ids to [S, 1, 2, 1]
+    auto transposed = std::make_shared<ov::op::v1::Transpose>(ids, ov::op::v0::Constant::create(ov::element::i64, {2}, {1, 0}));
+    auto sequence_last = std::make_shared<ov::op::v0::Unsqueeze>(transposed, ov::op::v0::Constant::create(ov::element::i64, {2}, {2, 3}));
+    auto sequence_first = std::make_shared<ov::op::v0::Concat>(ov::OutputVector{sequence_last, sequence_last}, 2);
+
+    ov::SinkVector sinks = {cache("batch_first", ov::PartialShape{-1, 2, -1, 1}, ov::Shape{1, 2, 0, 1}, 0, 2, batch_first),
+                            cache("sequence_first", ov::PartialShape{-1, -1, 2, 1}, ov::Shape{0, 1, 2, 1}, 1, 0, sequence_first)};
+    return std::make_shared<ov::Model>(ov::ResultVector{std::make_shared<ov::op::v0::Result>(inputs.logits)}, sinks,
+                                       ov::ParameterVector{inputs.input_ids, inputs.attention_mask, beam_idx});
+}
+
+static int check_inputs(ov::Core &core)
+{
+    ov::CompiledModel compiled = core.compile_model(mask_sum_model(), "CPU");
+    // Shares the request with the session, to read back what it binds
+    ov::InferRequest request = compiled.create_infer_request();
+    ovllm::Session session(request, ovllm::ArenaAllocator{std::make_shared<ovllm::Arena>()});
+
+    // A prefill, single token decode steps, and multi-token steps like prompt lookup verification,
+    // so that views shrink and grow within a buffer and buffers are replaced
+    std::vector<size_t> steps = {5};
+    for (size_t i = 0; i < 48; ++i)
+    {
+        steps.push_back(i % 8 == 7 ? 3 : 1);
+    }
+    int failures = 0;
+    int64_t token = 1;
+    for (size_t step = 0; step < steps.size(); ++step)
+    {
+        std::vector<int64_t> tokens;
+        for (size_t i = 0; i < steps[step]; ++i)
+        {
+            tokens.push_back(token++);
+        }
+        ovllm::Logits logits = session.forward(tokens.data(), tokens.size());
+
+        const ov::Tensor mask = request.get_tensor("attention_mask");
+        if (mask.get_size() != session.length())
+        {
+            std::fprintf(stderr, "step %zu: attention_mask has %zu elements for %zu positions\n", step, mask.get_size(), session.length());
+            ++failures;
+        }
+        const int64_t *values = mask.data<int64_t>();
+        for (size_t i = 0; i < mask.get_size(); ++i)
+        {
+            if (values[i] != 1)
+            {
+                std::fprintf(stderr, "step %zu: attention_mask[%zu] is %lld\n", step, i, static_cast<long long>(values[i]));
+                ++failures;
+                break;
+            }
+        }
+        const float *rows = logits.values.data<float>();
+        for (size_t i = 0; i < tokens.size(); ++i)
+        {
+            const float expected = float(tokens[i]) * float(session.length());
+            if (rows[i] != expected)
+            {
+                std::fprintf(stderr, "step %zu: logits[%zu] is %g, expected %g\n", step, i, rows[i], expected);
+                ++failures;
+                break;
+            }
+        }
+    }
+    if (failures == 0)
+    {
+        std::printf("session_test: %zu steps passed\n", steps.size());
+    }
+    return failures;
+}
+
+// Compares a KV cache with the expected elements in memory order
+static int check_state(ov::InferRequest &request, const std::string &id, const ov::Shape &shape, const std::vector<float> &expected)
+{
+    for (auto &state : request.query_state())
+    {
+        if (state.get_name() != id)
+        {
+            continue;
+        }
+        ov::Tensor cache = state.get_state();
+        if (cache.get_shape() != shape)
+        {
+            std::fprintf(stderr, "%s: shape is %s, expected %s\n", id.c_str(), cache.get_shape().to_string().c_str(),
+                         shape.to_string().c_str());
+            return 1;
+        }
+        const float *values = cache.data<float>();
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            if (values[i] != expected[i])
+            {
+                std::fprintf(stderr, "%s: element %zu is %g, expected %g\n", id.c_str(), i, values[i], expected[i]);
+                return 1;
+            }
+        }
+        return 0;
+    }
+    std::fprintf(stderr, "%s: no such state\n", id.c_str());
+    return 1;
+}
+
+static int check_trim(ov::Core &core)
+{
+    std::shared_ptr<ov::Model> model = kv_cache_model();
+    ov::CompiledModel compiled = core.compile_model(model, "CPU");
+    ov::InferRequest request = compiled.create_infer_request();
+    ovllm::Session session(request, ovllm::ArenaAllocator{std::make_shared<ovllm::Arena>()}, ovllm::sequence_axes(*model));
+
+    int failures = 0;
+    const std::vector<int64_t> prompt = {1, 2, 3, 4, 5};
+    session.forward(prompt.data(), prompt.size());
+    session.trim(2);
+    failures += check_state(request, "batch_first", {1, 2, 3, 1}, {1, 2, 3, 1, 2, 3});
+    failures += check_state(request, "sequence_first", {3, 1, 2, 1}, {1, 1, 2, 2, 3, 3});
+
+    // Decoding continues from the trimmed caches
+    const int64_t token = 9;
+    session.forward(&token, 1);
+    failures += check_state(request, "batch_first", {1, 2, 4, 1}, {1, 2, 3, 9, 1, 2, 3, 9});
+    failures += check_state(request, "sequence_first", {4, 1, 2, 1}, {1, 1, 2, 2, 3, 3, 9, 9});
+    if (failures == 0)
+    {
+        std::printf("session_test: trim passed\n");
+    }
+    return failures;
+}
+
+int main()
+{
+    ov::Core core;
+    const int failures = check_inputs(core) + check_trim(core);
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "session_test: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
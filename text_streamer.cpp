@@ -0,0 +1,135 @@
+#include "text_streamer.hpp"
+
+#include <algorithm>
+
+#include "tracer.hpp"
+
+namespace ovllm
+{
+    // Tokens kept as decoding context once the window is rebased
+    static constexpr size_t kAnchorTokens = 3;
+    static constexpr size_t kMaxWindow = 16;
+    // U+FFFD, what detokenizers emit for byte tokens that do not form a full character yet
+    static const std::string kReplacementCharacter = "\xEF\xBF\xBD";
+
+    size_t incomplete_utf8_tail(const std::string &text)
+    {
+        const size_t size = text.size();
+        for (size_t i = 1; i <= std::min<size_t>(4, size); ++i)
+        {
+            const unsigned char byte = text[size - i];
+            if ((byte & 0xC0) == 0x80)
+            {
+                continue;
+            }
+            size_t length = 1;
+            if ((byte & 0xE0) == 0xC0)
+            {
+                length = 2;
+            }
+            else if ((byte & 0xF0) == 0xE0)
+            {
+                length = 3;
+            }
+            else if ((byte & 0xF8) == 0xF0)
+            {
+                length = 4;
+            }
+            return length > i ? i : 0;
+        }
+        return 0;
+    }
+
+    static bool ends_with_replacement(const std::string &text)
+    {
+        return text.size() >= kReplacementCharacter.size() &&
+               text.compare(text.size() - kReplacementCharacter.size(), kReplacementCharacter.size(), kReplacementCharacter) == 0;
+    }
+
+    TextStreamer::TextStreamer(const ov::genai::Tokenizer &tokenizer, Callback callback, const std::vector<std::string> &stop)
+        : m_tokenizer(tokenizer), m_callback(std::move(callback)), m_stop(stop)
+    {
+    }
+
+    std::string TextStreamer::decode_window()
+    {
+        trace::Span span("detokenize");
+        const auto start = std::chrono::steady_clock::now();
+        std::string text = m_tokenizer.decode(m_window);
+        m_decode_time += std::chrono::steady_clock::now() - start;
+        return text;
+    }
+
+    bool TextStreamer::emit(const std::string &chunk)
+    {
+        if (m_stop.empty())
+        {
+            return m_callback(chunk);
+        }
+        const size_t held = m_held.size();
+        m_held += chunk;
+        const size_t matched = m_stop.feed(chunk);
+        if (matched != StopMatcher::npos)
+        {
+            m_stopped = true;
+            const size_t start = held + matched - m_stop.match_length();
+            if (start > 0)
+            {
+                m_callback(m_held.substr(0, start));
+            }
+            m_held.clear();
+            return true;
+        }
+        const size_t ready = m_held.size() - m_stop.pending();
+        if (ready == 0)
+        {
+            return false;
+        }
+        bool stop = m_callback(m_held.substr(0, ready));
+        m_held.erase(0, ready);
+        return stop;
+    }
+
+    bool TextStreamer::put(int64_t token)
+    {
+        if (m_stopped)
+        {
+            return true;
+        }
+        m_window.push_back(token);
+        std::string text = decode_window();
+        if (text.size() <= m_anchor_text.size() || incomplete_utf8_tail(text) > 0 || ends_with_replacement(text))
+        {
+            return false;
+        }
+        std::string chunk = text.substr(m_anchor_text.size());
+
+        if (m_window.size() > kMaxWindow)
+        {
+            m_window.erase(m_window.begin(), m_window.end() - kAnchorTokens);
+            m_anchor_text = decode_window();
+        }
+        else
+        {
+            m_anchor_text = std::move(text);
+        }
+        return emit(chunk);
+    }
+
+    void TextStreamer::end()
+    {
+        std::string text = decode_window();
+        if (!m_stopped && text.size() > m_anchor_text.size())
+        {
+            emit(text.substr(m_anchor_text.size()));
+        }
+        if (!m_stopped && !m_held.empty())
+        {
+            m_callback(m_held);
+        }
+        m_window.clear();
+        m_anchor_text.clear();
+        m_held.clear();
+        m_stop.reset();
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "openvino/genai/streamer_base.hpp"
+#include "openvino/genai/tokenizer.hpp"
+#include "stop_matcher.hpp"
+
+namespace ovllm
+{
+    // Detokenizes incrementally: each put() decodes only a short window of recent tokens and
+    // emits the text it adds, holding back chunks that end in an incomplete UTF-8 sequence.
+    // With stop strings, text that may be the start of one is held back too, and generation
+    // stops once one is found, emitting the text before it.
+    class TextStreamer : public ov::genai::StreamerBase
+    {
+    public:
+        // Receives complete UTF-8 chunks, returns true to stop generation.
+        using Callback = std::function<bool(const std::string &)>;
+
+        TextStreamer(const ov::genai::Tokenizer &tokenizer, Callback callback, const std::vector<std::string> &stop = {});
+
+        bool put(int64_t token) override;
+        void end() override;
+        bool stopped() const { return m_stopped; }
+        // Time spent in the detokenizer so far.
+        std::chrono::steady_clock::duration decode_time() const { return m_decode_time; }
+
+    private:
+        std::string decode_window();
+        bool emit(const std::string &chunk);
+
+        ov::genai::Tokenizer m_tokenizer;
+        Callback m_callback;
+        // Already emitted anchor tokens followed by pending ones, decoded together so that
+        // merges and leading spaces come out as in the full text
+        std::vector<int64_t> m_window;
+        std::string m_anchor_text;
+        StopMatcher m_stop;
+        // Decoded text that might turn out to be part of a stop string
+        std::string m_held;
+        bool m_stopped = false;
+        std::chrono::steady_clock::duration m_decode_time{};
+    };
+
+    // Number of trailing bytes of text that start a UTF-8 sequence which is not complete yet.
+    size_t incomplete_utf8_tail(const std::string &text);
+}
@@ -0,0 +1,34 @@
+#include "token_streamer.hpp"
+
+#include <algorithm>
+
+namespace ovllm
+{
+    TokenStreamer::TokenStreamer(size_t chunk_size, Callback callback)
+        : m_chunk_size(std::max<size_t>(chunk_size, 1)), m_callback(std::move(callback))
+    {
+        m_chunk.reserve(m_chunk_size);
+    }
+
+    bool TokenStreamer::put(int64_t token)
+    {
+        m_chunk.push_back(static_cast<int32_t>(token));
+        return m_chunk.size() >= m_chunk_size && flush();
+    }
+
+    void TokenStreamer::end()
+    {
+        flush();
+    }
+
+    bool TokenStreamer::flush()
+    {
+        if (m_chunk.empty())
+        {
+            return false;
+        }
+        bool stop = m_callback(m_chunk.data(), m_chunk.size());
+        m_chunk.clear();
+        return stop;
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "openvino/genai/streamer_base.hpp"
+
+namespace ovllm
+{
+    // Buffers generated token ids and hands them out in chunks, without detokenizing.
+    class TokenStreamer : public ov::genai::StreamerBase
+    {
+    public:
+        // Receives a chunk of token ids, returns true to stop generation.
+        using Callback = std::function<bool(const int32_t *tokens, size_t count)>;
+
+        TokenStreamer(size_t chunk_size, Callback callback);
+
+        bool put(int64_t token) override;
+        void end() override;
+
+    private:
+        bool flush();
+
+        size_t m_chunk_size;
+        Callback m_callback;
+        std::vector<int32_t> m_chunk;
+    };
+}
@@ -0,0 +1,185 @@
+#include "tracer.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+namespace ovllm
+{
+    namespace trace
+    {
+        // Events kept per thread, older ones are overwritten
+        static constexpr size_t kRingSize = 1 << 16;
+
+        std::atomic<bool> g_enabled{false};
+
+        struct Event
+        {
+            const char *name;
+            int64_t begin_us;
+            int64_t duration_us;
+            uint64_t request;
+        };
+
+        struct ThreadBuffer
+        {
+            uint32_t tid = 0;
+            std::string name;
+            std::unique_ptr<Event[]> events{new Event[kRingSize]};
+            // Only the owning thread writes, stop() reads up to the published count
+            std::atomic<size_t> written{0};
+        };
+
+        // Profiled nodes have dynamic names, they are rare enough to share one locked list
+        struct NodeEvent
+        {
+            uint32_t tid;
+            std::string name;
+            std::string type;
+            int64_t begin_us;
+            int64_t duration_us;
+            uint64_t request;
+        };
+
+        static std::mutex g_mutex;
+        static std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+        static std::vector<NodeEvent> g_nodes;
+        static const Clock::time_point g_epoch = Clock::now();
+
+        static int64_t micros(Clock::time_point time)
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(time - g_epoch).count();
+        }
+
+        // Registered once per thread, buffers outlive their threads so that stop() can still read them
+        static ThreadBuffer &thread_buffer()
+        {
+            thread_local ThreadBuffer *buffer = nullptr;
+            if (buffer == nullptr)
+            {
+                std::lock_guard<std::mutex> lock(g_mutex);
+                g_buffers.push_back(std::make_unique<ThreadBuffer>());
+                buffer = g_buffers.back().get();
+                buffer->tid = uint32_t(g_buffers.size());
+                buffer->name = "thread " + std::to_string(buffer->tid);
+            }
+            return *buffer;
+        }
+
+        void name_thread(const char *name)
+        {
+            ThreadBuffer &buffer = thread_buffer();
+            std::lock_guard<std::mutex> lock(g_mutex);
+            buffer.name = name;
+        }
+
+        void record(const char *name, Clock::time_point begin, Clock::time_point end, uint64_t request)
+        {
+            ThreadBuffer &buffer = thread_buffer();
+            const size_t index = buffer.written.load(std::memory_order_relaxed);
+            buffer.events[index % kRingSize] = Event{name, micros(begin), micros(end) - micros(begin), request};
+            buffer.written.store(index + 1, std::memory_order_release);
+        }
+
+        void record_nodes(Clock::time_point begin, const std::vector<ov::ProfilingInfo> &nodes, uint64_t request)
+        {
+            const uint32_t tid = thread_buffer().tid;
+            int64_t at = micros(begin);
+            std::lock_guard<std::mutex> lock(g_mutex);
+            for (const ov::ProfilingInfo &node : nodes)
+            {
+                if (node.status != ov::ProfilingInfo::Status::EXECUTED)
+                {
+                    continue;
+                }
+                g_nodes.push_back(NodeEvent{tid, node.node_name, node.node_type + " " + node.exec_type, at, node.real_time.count(), request});
+                at += node.real_time.count();
+            }
+        }
+
+        void start()
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            for (auto &buffer : g_buffers)
+            {
+                buffer->written.store(0, std::memory_order_relaxed);
+            }
+            g_nodes.clear();
+            g_enabled.store(true, std::memory_order_relaxed);
+        }
+
+        static std::string escape(const std::string &text)
+        {
+            std::string out;
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    out += '\\';
+                }
+                if (static_cast<unsigned char>(c) >= 0x20)
+                {
+                    out += c;
+                }
+            }
+            return out;
+        }
+
+        static void separate(std::string &out)
+        {
+            out += out.back() == '[' ? "\n" : ",\n";
+        }
+
+        static void append_thread_name(std::string &out, uint32_t tid, const std::string &name)
+        {
+            separate(out);
+            out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(tid) + ",\"args\":{\"name\":\"" +
+                   escape(name) + "\"}}";
+        }
+
+        static void append_event(std::string &out, const std::string &name, const char *category, uint32_t tid, int64_t begin_us,
+                                 int64_t duration_us, uint64_t request)
+        {
+            char fields[160];
+            std::snprintf(fields, sizeof(fields), "\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lld,\"dur\":%lld", category,
+                          tid, static_cast<long long>(begin_us), static_cast<long long>(duration_us));
+            separate(out);
+            out += "{\"name\":\"" + escape(name) + fields;
+            if (request != 0)
+            {
+                out += ",\"args\":{\"request\":" + std::to_string(request) + "}";
+            }
+            out += "}";
+        }
+
+        std::string stop()
+        {
+            g_enabled.store(false, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(g_mutex);
+            std::string out = "{\"traceEvents\":[";
+            // Node tracks are numbered after the thread tracks
+            const uint32_t node_track = uint32_t(g_buffers.size());
+            for (const auto &buffer : g_buffers)
+            {
+                append_thread_name(out, buffer->tid, buffer->name);
+                if (!g_nodes.empty())
+                {
+                    append_thread_name(out, node_track + buffer->tid, buffer->name + " nodes");
+                }
+                const size_t written = buffer->written.load(std::memory_order_acquire);
+                for (size_t i = written > kRingSize ? written - kRingSize : 0; i < written; ++i)
+                {
+                    const Event &event = buffer->events[i % kRingSize];
+                    append_event(out, event.name, "ovllm", buffer->tid, event.begin_us, event.duration_us, event.request);
+                }
+            }
+            for (const NodeEvent &node : g_nodes)
+            {
+                append_event(out, node.name + " (" + node.type + ")", "node", node_track + node.tid, node.begin_us, node.duration_us,
+                             node.request);
+            }
+            out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+            return out;
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "openvino/runtime/profiling_info.hpp"
+
+namespace ovllm
+{
+    // Opt-in timeline of the request lifecycle in Chrome Trace Event format (chrome://tracing, Perfetto).
+    // Spans go to a ring buffer of the recording thread, written by that thread alone without locks.
+    // While tracing is off a span costs one relaxed atomic load.
+    namespace trace
+    {
+        using Clock = std::chrono::steady_clock;
+
+        extern std::atomic<bool> g_enabled;
+
+        inline bool enabled()
+        {
+            return g_enabled.load(std::memory_order_relaxed);
+        }
+
+        // Clears the buffers of every thread and starts recording.
+        void start();
+        // Stops recording and returns the events as Chrome Trace Event JSON.
+        std::string stop();
+
+        // Names the calling thread's track.
+        void name_thread(const char *name);
+        // name must outlive the trace, usually a literal. request ties spans of one request together.
+        void record(const char *name, Clock::time_point begin, Clock::time_point end, uint64_t request = 0);
+        // Lays the executed nodes of a profiled forward pass end to end from begin, on a node track
+        // under the calling thread.
+        void record_nodes(Clock::time_point begin, const std::vector<ov::ProfilingInfo> &nodes, uint64_t request);
+
+        // Records the span of its own lifetime.
+        class Span
+        {
+        public:
+            explicit Span(const char *name, uint64_t request = 0)
+                : m_name(enabled() ? name : nullptr), m_request(request), m_begin(m_name ? Clock::now() : Clock::time_point())
+            {
+            }
+            ~Span()
+            {
+                if (m_name != nullptr)
+                {
+                    record(m_name, m_begin, Clock::now(), m_request);
+                }
+            }
+            Span(const Span &) = delete;
+            Span &operator=(const Span &) = delete;
+
+            Clock::time_point begin() const { return m_begin; }
+
+        private:
+            const char *m_name;
+            uint64_t m_request;
+            Clock::time_point m_begin;
+        };
+    }
+}